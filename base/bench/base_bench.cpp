@@ -0,0 +1,466 @@
+// Benchmarks of base/ task system.
+//
+// Usage: base_bench [output.json]
+//
+// Every benchmark runs against every TaskQueue and TaskPump implementation.
+// Results are written as JSON, one result per line in stable order, so
+// results of two builds can be compared with plain diff.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dispatch_task.h"
+#include "pending_task.h"
+#include "priority_task_queue.h"
+#include "run_loop.h"
+#include "steady_time_provider.h"
+#include "task_loop.h"
+#include "task_pump_std.h"
+#if defined(__linux__)
+#include "task_pump_epoll.h"
+#endif
+#include "task_pump_virtual.h"
+#include "thread_pool_run_loop.h"
+#include "timing_wheel_task_queue.h"
+#include "virtual_time_provider.h"
+
+namespace mk {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t kThroughputTasksCount = 200000;
+constexpr std::size_t kLatencySamplesCount = 2000;
+constexpr std::size_t kDelayedTasksCount = 200;
+constexpr std::size_t kCancelTasksCount = 100000;
+constexpr std::size_t kRepeatTimes = 100000;
+constexpr std::size_t kQueueTasksCount = 100000;
+constexpr std::size_t kVirtualTimersCount = 200;
+constexpr auto kVirtualDuration = std::chrono::hours{1};
+
+/**
+ * @brief Single measured value.
+ *
+ */
+struct Result {
+  std::string benchmark;
+  std::string subject;
+  std::size_t threads{1};
+  std::string metric;
+  double value{0};
+  std::string unit;
+};
+
+/**
+ * @brief Collects results and writes them as JSON.
+ *
+ */
+class Reporter {
+ public:
+  void Add(Result result) {
+    std::cerr << result.benchmark << " " << result.subject << " x"
+              << result.threads << " " << result.metric << ": "
+              << result.value << " " << result.unit << "\n";
+    results_.push_back(std::move(result));
+  }
+
+  void Write(std::ostream& stream) const {
+    stream << "{\"results\":[\n";
+    for (std::size_t i = 0; i < results_.size(); ++i) {
+      const auto& result = results_[i];
+      stream << "{\"benchmark\":\"" << result.benchmark << "\",\"subject\":\""
+             << result.subject << "\",\"threads\":" << result.threads
+             << ",\"metric\":\"" << result.metric
+             << "\",\"value\":" << result.value << ",\"unit\":\""
+             << result.unit << "\"}" << (i + 1 < results_.size() ? "," : "")
+             << "\n";
+    }
+    stream << "]}\n";
+  }
+
+ private:
+  std::vector<Result> results_;
+};
+
+/**
+ * @brief Counts finished tasks and wakes up waiter when all are done.
+ *
+ */
+class Completion {
+ public:
+  explicit Completion(std::size_t expected) : expected_{expected} {}
+
+  void Done() {
+    if (++done_ == expected_) {
+      std::lock_guard lock{guard_};
+      event_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock lock{guard_};
+    event_.wait(lock, [this]() { return done_ == expected_; });
+  }
+
+ private:
+  const std::size_t expected_;
+  std::atomic<std::size_t> done_{0};
+  std::mutex guard_;
+  std::condition_variable event_;
+};
+
+struct QueueFactory {
+  const char* name;
+  std::function<std::unique_ptr<TaskQueue>(std::shared_ptr<TimeProvider>)>
+      create;
+};
+
+struct PumpFactory {
+  const char* name;
+  std::function<std::unique_ptr<TaskPump>()> create;
+};
+
+/**
+ * @brief Loop running on its own thread.
+ *
+ */
+struct LoopUnderTest {
+  std::string name;
+  std::shared_ptr<TaskLoop> loop;
+  std::shared_ptr<DispatchTask> dispatcher;
+  std::thread thread;
+
+  void Start() {
+    thread = std::thread{[loop = loop]() { loop->Run(); }};
+  }
+
+  void Stop() {
+    loop->Stop();
+    thread.join();
+  }
+};
+
+using LoopFactory = std::function<LoopUnderTest()>;
+
+std::vector<QueueFactory> GetQueueFactories() {
+  return {
+      {"PriorityTaskQueue",
+       [](std::shared_ptr<TimeProvider>) {
+         return std::make_unique<PriorityTaskQueue>();
+       }},
+      {"TimingWheelTaskQueue",
+       [](std::shared_ptr<TimeProvider> time_provider) {
+         return std::make_unique<TimingWheelTaskQueue>(
+             std::move(time_provider));
+       }},
+  };
+}
+
+std::vector<PumpFactory> GetPumpFactories() {
+  return {
+      {"TaskPumpStd", []() { return std::make_unique<TaskPumpStd>(); }},
+#if defined(__linux__)
+      {"TaskPumpEpoll", []() { return std::make_unique<TaskPumpEpoll>(); }},
+#endif
+  };
+}
+
+std::vector<std::pair<std::string, LoopFactory>> GetLoopFactories() {
+  std::vector<std::pair<std::string, LoopFactory>> factories;
+
+  for (const auto& queue : GetQueueFactories()) {
+    for (const auto& pump : GetPumpFactories()) {
+      auto name = std::string{"RunLoop/"} + queue.name + "/" + pump.name;
+      factories.emplace_back(name, [name, queue, pump]() {
+        auto time_provider = std::make_shared<SteadyTimeProvider>();
+        auto loop = std::make_shared<RunLoop>(
+            pump.create(), queue.create(time_provider), time_provider);
+        return LoopUnderTest{name, loop, loop, {}};
+      });
+    }
+
+    auto name = std::string{"ThreadPoolRunLoop/"} + queue.name;
+    factories.emplace_back(name, [name, queue]() {
+      auto time_provider = std::make_shared<SteadyTimeProvider>();
+      auto loop = std::make_shared<ThreadPoolRunLoop>(
+          ThreadPoolOptions{std::max(2u, std::thread::hardware_concurrency())},
+          queue.create(time_provider), time_provider);
+      return LoopUnderTest{name, loop, loop, {}};
+    });
+  }
+
+  return factories;
+}
+
+double ToNanoseconds(Clock::duration duration) {
+  return static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+double GetPercentile(std::vector<double>& samples, double percentile) {
+  std::sort(samples.begin(), samples.end());
+  const auto index = static_cast<std::size_t>(
+      percentile * static_cast<double>(samples.size() - 1));
+  return samples[index];
+}
+
+void AddPercentiles(Reporter& reporter, const std::string& benchmark,
+                    const std::string& subject,
+                    std::vector<double>& samples_us) {
+  for (const auto& [metric, percentile] :
+       {std::pair{"p50", 0.5}, std::pair{"p90", 0.9}, std::pair{"p99", 0.99},
+        std::pair{"max", 1.0}}) {
+    reporter.Add({benchmark, subject, 1, metric,
+                  GetPercentile(samples_us, percentile), "us"});
+  }
+}
+
+void BenchPostThroughput(const LoopFactory& factory, Reporter& reporter) {
+  const auto max_producers =
+      std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+  for (std::size_t producers = 1; producers <= max_producers;
+       producers *= 2) {
+    auto subject = factory();
+    subject.Start();
+
+    Completion completion{kThroughputTasksCount};
+    const auto tasks_per_producer = kThroughputTasksCount / producers;
+    const auto tasks_count = tasks_per_producer * producers;
+
+    const auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < producers; ++i) {
+      threads.emplace_back([&]() {
+        for (std::size_t j = 0; j < tasks_per_producer; ++j) {
+          subject.dispatcher->PostTask([&completion]() { completion.Done(); });
+        }
+      });
+    }
+    for (std::size_t i = tasks_count; i < kThroughputTasksCount; ++i) {
+      subject.dispatcher->PostTask([&completion]() { completion.Done(); });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    completion.Wait();
+    const auto elapsed = Clock::now() - start;
+
+    subject.Stop();
+
+    reporter.Add({"post_throughput", subject.name, producers, "tasks_per_s",
+                  static_cast<double>(kThroughputTasksCount) * 1e9 /
+                      ToNanoseconds(elapsed),
+                  "1/s"});
+  }
+}
+
+void BenchPostLatency(const LoopFactory& factory, Reporter& reporter) {
+  auto subject = factory();
+  subject.Start();
+
+  std::vector<double> samples_us(kLatencySamplesCount);
+  for (std::size_t i = 0; i < kLatencySamplesCount; ++i) {
+    Completion completion{1};
+    const auto post_time = Clock::now();
+    subject.dispatcher->PostTask([&, i]() {
+      samples_us[i] = ToNanoseconds(Clock::now() - post_time) / 1000;
+      completion.Done();
+    });
+    completion.Wait();
+
+    // Let loop fall asleep, so wake up is measured too.
+    std::this_thread::sleep_for(std::chrono::microseconds{50});
+  }
+
+  subject.Stop();
+  AddPercentiles(reporter, "post_to_run_latency", subject.name, samples_us);
+}
+
+void BenchDelayedAccuracy(const LoopFactory& factory, Reporter& reporter) {
+  auto subject = factory();
+  subject.Start();
+
+  std::mt19937 random{42};
+  std::uniform_int_distribution<int> delays{1, 20};
+
+  std::vector<double> samples_us(kDelayedTasksCount);
+  Completion completion{kDelayedTasksCount};
+  for (std::size_t i = 0; i < kDelayedTasksCount; ++i) {
+    const auto delay = IntervalMs{delays(random)};
+    const auto expected_time = Clock::now() + delay;
+    subject.dispatcher->PostDelayedTask(
+        [&, i, expected_time]() {
+          samples_us[i] = ToNanoseconds(Clock::now() - expected_time) / 1000;
+          completion.Done();
+        },
+        delay);
+  }
+  completion.Wait();
+
+  subject.Stop();
+  AddPercentiles(reporter, "delayed_task_lateness", subject.name, samples_us);
+}
+
+void BenchCancel(const LoopFactory& factory, Reporter& reporter) {
+  auto subject = factory();
+  subject.Start();
+
+  std::vector<TaskHandle> handles;
+  handles.reserve(kCancelTasksCount);
+  for (std::size_t i = 0; i < kCancelTasksCount; ++i) {
+    handles.push_back(subject.dispatcher->PostDelayedTask(
+        []() {}, IntervalMs{60000 + static_cast<int>(i % 1000)}));
+  }
+
+  const auto start = Clock::now();
+  for (auto& handle : handles) {
+    subject.dispatcher->CancelTask(std::move(handle));
+  }
+  const auto elapsed = Clock::now() - start;
+
+  subject.Stop();
+  reporter.Add({"cancel_delayed_task", subject.name, 1, "cost",
+                ToNanoseconds(elapsed) / kCancelTasksCount, "ns"});
+}
+
+void BenchRepeating(const LoopFactory& factory, Reporter& reporter) {
+  auto subject = factory();
+  subject.Start();
+
+  Completion completion{kRepeatTimes};
+  const auto start = Clock::now();
+  subject.dispatcher->PostRepeatingTask([&completion]() { completion.Done(); },
+                                        kRepeatTimes, IntervalNs{0});
+  completion.Wait();
+  const auto elapsed = Clock::now() - start;
+
+  subject.Stop();
+  reporter.Add({"repeating_task", subject.name, 1, "cost_per_run",
+                ToNanoseconds(elapsed) / kRepeatTimes, "ns"});
+}
+
+void BenchQueue(const QueueFactory& factory, Reporter& reporter) {
+  std::mt19937 random{42};
+  std::uniform_int_distribution<int> times{1000, 11000};
+
+  std::unique_ptr<PendingTask[]> tasks{new PendingTask[kQueueTasksCount]};
+  for (std::size_t i = 0; i < kQueueTasksCount; ++i) {
+    tasks[i].next_call = TimestampMs{times(random)};
+  }
+
+  auto queue = factory.create(std::make_shared<VirtualTimeProvider>());
+
+  auto start = Clock::now();
+  for (std::size_t i = 0; i < kQueueTasksCount; ++i) {
+    queue->AddTask(&tasks[i]);
+  }
+  reporter.Add({"queue_add", factory.name, 1, "cost",
+                ToNanoseconds(Clock::now() - start) / kQueueTasksCount, "ns"});
+
+  // Remove every other task.
+  start = Clock::now();
+  for (std::size_t i = 0; i < kQueueTasksCount; i += 2) {
+    queue->RemoveTask(&tasks[i]);
+  }
+  reporter.Add({"queue_remove", factory.name, 1, "cost",
+                ToNanoseconds(Clock::now() - start) / (kQueueTasksCount / 2),
+                "ns"});
+
+  start = Clock::now();
+  std::size_t popped_count = 0;
+  while (!queue->IsEmpty()) {
+    queue->GetNextTaskCallTime();
+    queue->PopTask();
+    ++popped_count;
+  }
+  reporter.Add({"queue_pop", factory.name, 1, "cost",
+                ToNanoseconds(Clock::now() - start) /
+                    static_cast<double>(popped_count),
+                "ns"});
+}
+
+// Runs an hour of timers in virtual time. Runs and wakeups counts are exact,
+// so they change only if scheduling policy changes.
+void BenchVirtualSchedule(const QueueFactory& factory, Reporter& reporter) {
+  auto time_provider = std::make_shared<VirtualTimeProvider>();
+  auto loop = std::make_shared<RunLoop>(
+      std::make_unique<TaskPumpVirtual>(time_provider),
+      factory.create(time_provider), time_provider);
+
+  std::mt19937 random{42};
+  std::uniform_int_distribution<int> periods{10, 10000};
+
+  std::size_t runs_count = 0;
+  std::size_t wakeups_count = 0;
+  auto last_run_time = TimestampNs::min();
+  for (std::size_t i = 0; i < kVirtualTimersCount; ++i) {
+    const auto period = IntervalMs{periods(random)};
+    const auto repeat_mode =
+        i % 2 == 0 ? RepeatMode::kFixedRate : RepeatMode::kFixedDelay;
+    loop->PostRepeatingTask(
+        [&]() {
+          ++runs_count;
+          if (const auto now = time_provider->Now(); now != last_run_time) {
+            ++wakeups_count;
+            last_run_time = now;
+          }
+        },
+        std::numeric_limits<std::size_t>::max(), period,
+        TaskPriority::kUserVisible,
+        TimerOptions{repeat_mode, i % 4 < 2 ? IntervalNs{0} : period / 10});
+  }
+  loop->PostDelayedTask([&loop]() { loop->Stop(); }, kVirtualDuration);
+
+  const auto start = Clock::now();
+  loop->Run();
+  const auto elapsed = Clock::now() - start;
+
+  reporter.Add({"virtual_schedule", factory.name, 1, "runs",
+                static_cast<double>(runs_count), "count"});
+  reporter.Add({"virtual_schedule", factory.name, 1, "wakeups",
+                static_cast<double>(wakeups_count), "count"});
+  reporter.Add({"virtual_schedule", factory.name, 1, "wall_time",
+                ToNanoseconds(elapsed) / 1e6, "ms"});
+}
+}  // namespace
+}  // namespace mk
+
+int main(int argc, char** argv) {
+  using namespace mk;
+
+  Reporter reporter;
+
+  for (const auto& queue : GetQueueFactories()) {
+    BenchQueue(queue, reporter);
+    BenchVirtualSchedule(queue, reporter);
+  }
+
+  for (const auto& [name, factory] : GetLoopFactories()) {
+    BenchPostThroughput(factory, reporter);
+    BenchPostLatency(factory, reporter);
+    BenchDelayedAccuracy(factory, reporter);
+    BenchCancel(factory, reporter);
+    BenchRepeating(factory, reporter);
+  }
+
+  if (argc > 1) {
+    std::ofstream output{argv[1]};
+    reporter.Write(output);
+  } else {
+    reporter.Write(std::cout);
+  }
+
+  return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+namespace mk {
+/**
+ * @brief Bind callable to owner which may die before callable is called.
+ *
+ * Returned callable locks owner and calls callable(owner, args...) only if
+ * owner is still alive. Otherwise call is dropped.
+ *
+ * @param owner Object callable works on.
+ * @param callable Callable accepting owner reference as first argument.
+ * @return Callable with the rest of arguments.
+ */
+template <typename Owner, typename Callable>
+auto BindWeak(std::weak_ptr<Owner> owner, Callable callable) {
+  return [owner = std::move(owner),
+          callable = std::move(callable)](auto&&... args) mutable {
+    if (auto locked_owner = owner.lock()) {
+      callable(*locked_owner, std::forward<decltype(args)>(args)...);
+    }
+  };
+}
+}  // namespace mk
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <vector>
+
 #include "task_handle.h"
+#include "task_priority.h"
+#include "timer_options.h"
 
 namespace mk {
 /**
@@ -15,9 +19,22 @@ class DispatchTask {
    * @brief Post immeadetly task.
    *
    * @param task Task to be done.
+   * @param priority Task priority.
    * @return Task handle.
    */
-  virtual TaskHandle PostTask(Task task) = 0;
+  virtual TaskHandle PostTask(Task task, TaskPriority priority) = 0;
+
+  /**
+   * @brief Post several immeadetly tasks at once.
+   *
+   * Tasks are enqueued together and dispatcher is woken up once.
+   *
+   * @param tasks Tasks to be done in given order.
+   * @param priority Priority of all tasks.
+   * @return Task handles in order of tasks.
+   */
+  virtual std::vector<TaskHandle> PostTasks(std::vector<Task> tasks,
+                                            TaskPriority priority) = 0;
 
   /**
    * @brief Post repeating task.
@@ -25,19 +42,26 @@ class DispatchTask {
    * @param task Task to be done.
    * @param times Task execution times.
    * @param period Delay between tasks execution.
+   * @param priority Task priority.
+   * @param options Repeat mode and slack.
    * @return Task handle.
    */
   virtual TaskHandle PostRepeatingTask(Task task, size_t times,
-                                       IntervalMs period) = 0;
+                                       IntervalNs period, TaskPriority priority,
+                                       TimerOptions options) = 0;
 
   /**
    * @brief Post delayed task.
    *
    * @param task Task to be done.
    * @param delay Delay before task execution.
+   * @param priority Task priority.
+   * @param options Slack of delay.
    * @return Task handle.
    */
-  virtual TaskHandle PostDelayedTask(Task task, IntervalMs delay) = 0;
+  virtual TaskHandle PostDelayedTask(Task task, IntervalNs delay,
+                                     TaskPriority priority,
+                                     TimerOptions options) = 0;
 
   /**
    * @brief Try to cancle task by handle.
@@ -45,5 +69,48 @@ class DispatchTask {
    * @param handle Task handle.
    */
   virtual void CancelTask(TaskHandle&& handle) = 0;
+
+  /**
+   * @brief Change priority of task which has not started yet.
+   *
+   * @param handle Task handle.
+   * @param priority New task priority.
+   */
+  virtual void UpdateTaskPriority(const TaskHandle& handle,
+                                  TaskPriority priority) = 0;
+
+  /** @brief Post user visible immeadetly task. */
+  TaskHandle PostTask(Task task) {
+    return PostTask(std::move(task), TaskPriority::kUserVisible);
+  }
+
+  /** @brief Post several user visible immeadetly tasks at once. */
+  std::vector<TaskHandle> PostTasks(std::vector<Task> tasks) {
+    return PostTasks(std::move(tasks), TaskPriority::kUserVisible);
+  }
+
+  /** @brief Post fixed delay repeating task without slack. */
+  TaskHandle PostRepeatingTask(Task task, size_t times, IntervalNs period,
+                               TaskPriority priority) {
+    return PostRepeatingTask(std::move(task), times, period, priority,
+                             TimerOptions{});
+  }
+
+  /** @brief Post delayed task without slack. */
+  TaskHandle PostDelayedTask(Task task, IntervalNs delay,
+                             TaskPriority priority) {
+    return PostDelayedTask(std::move(task), delay, priority, TimerOptions{});
+  }
+
+  /** @brief Post user visible repeating task. */
+  TaskHandle PostRepeatingTask(Task task, size_t times, IntervalNs period) {
+    return PostRepeatingTask(std::move(task), times, period,
+                             TaskPriority::kUserVisible);
+  }
+
+  /** @brief Post user visible delayed task. */
+  TaskHandle PostDelayedTask(Task task, IntervalNs delay) {
+    return PostDelayedTask(std::move(task), delay, TaskPriority::kUserVisible);
+  }
 };
-}  // namespace mk
\ No newline at end of file
+}  // namespace mk
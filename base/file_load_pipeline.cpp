@@ -0,0 +1,297 @@
+#include "file_load_pipeline.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "dispatch_task.h"
+#include "file_reader.h"
+
+namespace mk {
+FileLoadPipeline::FileLoadPipeline(
+    FileLoadPipelineOptions options, std::shared_ptr<FileReader> file_reader,
+    std::shared_ptr<DispatchTask> processing_dispatcher)
+    : state_{std::make_shared<State>()} {
+  if (options.max_processing_tasks == 0) {
+    options.max_processing_tasks =
+        std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  }
+
+  state_->options = options;
+  state_->file_reader = std::move(file_reader);
+  state_->processing_dispatcher = std::move(processing_dispatcher);
+}
+
+TaskHandle FileLoadPipeline::Load(std::filesystem::path path,
+                                  ProcessCallback process,
+                                  TaskPriority priority, Location location) {
+  std::uint32_t id = 0;
+  {
+    std::lock_guard lock{state_->guard};
+
+    // 0 is reserved for empty handle.
+    if (++state_->last_id == 0) {
+      ++state_->last_id;
+    }
+    id = state_->last_id;
+
+    auto& request = state_->requests[id];
+    request.path = std::move(path);
+    request.process = std::move(process);
+    request.priority = priority;
+    request.location = location;
+    PushRequestLocked(*state_, id, request, Stage::kWaitingRead);
+  }
+
+  Advance(state_);
+
+  return TaskHandle::FromId(state_->owner, id);
+}
+
+void FileLoadPipeline::CancelLoad(TaskHandle&& handle) {
+  // Request is destroyed out of lock, its callback may own anything.
+  if (handle.owner != state_->owner) {
+    return;
+  }
+
+  Request cancelled_request;
+  bool is_queue_freed = false;
+  {
+    std::lock_guard lock{state_->guard};
+    auto it = state_->requests.find(handle.id);
+    if (it == state_->requests.end()) {
+      return;
+    }
+
+    // Read and processing in flight see missing request and drop result.
+    auto& request = it->second;
+    RemoveRequestLocked(*state_, request);
+    if (request.stage == Stage::kWaitingProcessing) {
+      --state_->queued_files_count;
+      is_queue_freed = true;
+    }
+
+    cancelled_request = std::move(it->second);
+    state_->requests.erase(it);
+  }
+
+  if (is_queue_freed) {
+    Advance(state_);
+  }
+}
+
+void FileLoadPipeline::UpdateLoadPriority(const TaskHandle& handle,
+                                          TaskPriority priority) {
+  if (handle.owner != state_->owner) {
+    return;
+  }
+
+  std::lock_guard lock{state_->guard};
+  auto it = state_->requests.find(handle.id);
+  if (it == state_->requests.end() || it->second.priority == priority) {
+    return;
+  }
+
+  // Waiting load goes to the end of its new lane.
+  auto& request = it->second;
+  if (auto* queue = GetStageQueueLocked(*state_, request.stage)) {
+    auto& lanes = queue->lanes;
+    lanes[ToIndex(priority)].splice(lanes[ToIndex(priority)].end(),
+                                    lanes[ToIndex(request.priority)],
+                                    request.lane_position);
+  }
+  request.priority = priority;
+}
+
+FileLoadPipeline::StageQueue* FileLoadPipeline::GetStageQueueLocked(
+    State& state, Stage stage) {
+  switch (stage) {
+    case Stage::kWaitingRead:
+      return &state.waiting_reads;
+    case Stage::kWaitingProcessing:
+      return &state.waiting_processing;
+    case Stage::kReading:
+    case Stage::kProcessing:
+      break;
+  }
+
+  return nullptr;
+}
+
+void FileLoadPipeline::PushRequestLocked(State& state, std::uint32_t id,
+                                         Request& request, Stage stage) {
+  request.stage = stage;
+
+  auto& lane = GetStageQueueLocked(state, stage)->lanes[ToIndex(
+      request.priority)];
+  request.lane_position = lane.insert(lane.end(), id);
+}
+
+void FileLoadPipeline::RemoveRequestLocked(State& state, Request& request) {
+  if (auto* queue = GetStageQueueLocked(state, request.stage)) {
+    queue->lanes[ToIndex(request.priority)].erase(request.lane_position);
+  }
+}
+
+std::uint32_t FileLoadPipeline::PopRequestLocked(StageQueue& queue) {
+  unsigned non_empty_lanes = 0;
+  for (std::size_t i = 0; i < queue.lanes.size(); ++i) {
+    if (!queue.lanes[i].empty()) {
+      non_empty_lanes |= 1u << i;
+    }
+  }
+
+  const auto index = queue.selector.Select(non_empty_lanes);
+  if (index == kTaskPrioritiesCount) {
+    return 0;
+  }
+
+  auto& lane = queue.lanes[index];
+  const auto id = lane.front();
+  lane.pop_front();
+
+  return id;
+}
+
+void FileLoadPipeline::Advance(const std::shared_ptr<State>& state) {
+  /**
+   * @brief Processing to be posted out of lock.
+   *
+   */
+  struct Processing {
+    std::uint32_t id{0};
+    TaskPriority priority{TaskPriority::kUserVisible};
+    Location location;
+  };
+
+  /**
+   * @brief Read to be submitted out of lock.
+   *
+   */
+  struct Read {
+    std::uint32_t id{0};
+    std::filesystem::path path;
+    Location location;
+  };
+
+  std::vector<Processing> processings;
+  std::vector<Read> reads;
+  {
+    std::lock_guard lock{state->guard};
+    const auto& options = state->options;
+
+    while (state->processing_count < options.max_processing_tasks) {
+      const auto id = PopRequestLocked(state->waiting_processing);
+      if (id == 0) {
+        break;
+      }
+
+      auto& request = state->requests[id];
+      request.stage = Stage::kProcessing;
+      --state->queued_files_count;
+      ++state->processing_count;
+      processings.push_back(Processing{id, request.priority, request.location});
+    }
+
+    // Every read in flight holds a queue place for its file.
+    while (state->reads_count < options.max_reads_in_flight &&
+           state->reads_count + state->queued_files_count <
+               options.max_queued_files) {
+      const auto id = PopRequestLocked(state->waiting_reads);
+      if (id == 0) {
+        break;
+      }
+
+      auto& request = state->requests[id];
+      request.stage = Stage::kReading;
+      ++state->reads_count;
+      reads.push_back(Read{id, request.path, request.location});
+    }
+  }
+
+  std::vector<std::uint32_t> rejected_ids;
+  for (const auto& processing : processings) {
+    const auto handle = state->processing_dispatcher->PostTask(
+        Task{[state, id = processing.id]() { RunProcessing(state, id); },
+             processing.location},
+        processing.priority);
+    if (!handle.IsIssued()) {
+      rejected_ids.push_back(processing.id);
+    }
+  }
+
+  // Read completion only hands file over to processing queue, it goes ahead
+  // of processing tasks.
+  for (auto& read : reads) {
+    state->file_reader->ReadFile(
+        std::move(read.path), state->processing_dispatcher,
+        [state, id = read.id](std::error_code error,
+                              std::vector<std::byte> data) {
+          OnRead(state, id, error, std::move(data));
+        },
+        TaskPriority::kUserBlocking, read.location);
+  }
+
+  if (!rejected_ids.empty()) {
+    DropProcessing(state, rejected_ids);
+  }
+}
+
+void FileLoadPipeline::DropProcessing(const std::shared_ptr<State>& state,
+                                      const std::vector<std::uint32_t>& ids) {
+  // Request is destroyed out of lock, its callback may own anything.
+  std::vector<Request> dropped_requests;
+  std::lock_guard lock{state->guard};
+  state->processing_count -= ids.size();
+
+  for (const auto id : ids) {
+    if (auto it = state->requests.find(id); it != state->requests.end()) {
+      dropped_requests.push_back(std::move(it->second));
+      state->requests.erase(it);
+    }
+  }
+}
+
+void FileLoadPipeline::OnRead(const std::shared_ptr<State>& state,
+                              std::uint32_t id, std::error_code error,
+                              std::vector<std::byte> data) {
+  {
+    std::lock_guard lock{state->guard};
+    --state->reads_count;
+
+    if (auto it = state->requests.find(id); it != state->requests.end()) {
+      auto& request = it->second;
+      request.error = error;
+      request.data = std::move(data);
+
+      ++state->queued_files_count;
+      PushRequestLocked(*state, id, request, Stage::kWaitingProcessing);
+    }
+  }
+
+  Advance(state);
+}
+
+void FileLoadPipeline::RunProcessing(const std::shared_ptr<State>& state,
+                                     std::uint32_t id) {
+  Request request;
+  {
+    std::lock_guard lock{state->guard};
+    if (auto it = state->requests.find(id); it != state->requests.end()) {
+      request = std::move(it->second);
+      state->requests.erase(it);
+    }
+  }
+
+  if (request.process) {
+    request.process(request.error, std::move(request.data));
+  }
+
+  {
+    std::lock_guard lock{state->guard};
+    --state->processing_count;
+  }
+
+  Advance(state);
+}
+}  // namespace mk
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "location.h"
+#include "task_handle.h"
+#include "task_lanes.h"
+#include "task_priority.h"
+
+namespace mk {
+class DispatchTask;
+class FileReader;
+
+/**
+ * @brief File load pipeline configuration.
+ *
+ */
+struct FileLoadPipelineOptions {
+  /// Reads submitted to file reader at once.
+  std::size_t max_reads_in_flight{8};
+
+  /// Read files waiting for processing, reads in flight included. Reads are
+  /// paused while queue is full, so file buffers don't pile up when
+  /// processing is slower than disk.
+  std::size_t max_queued_files{32};
+
+  /// Processing tasks posted at once. Zero means one per CPU core.
+  std::size_t max_processing_tasks{0};
+};
+
+/**
+ * @brief Loads files in two stages: read stage and CPU processing stage,
+ * e.g. image decoding.
+ *
+ * Read stage keeps up to max_reads_in_flight reads in file reader. Read
+ * files wait in bounded queue, processing stage takes them to processing
+ * dispatcher up to max_processing_tasks at once. So slow read doesn't stall
+ * processing of files already read, and long processing doesn't stall next
+ * reads until queue is full. Both stages take loads by priority, lower
+ * priority loads still get their turn like in loop lanes.
+ *
+ * Loads are cancelled and reprioritized by handle, cancelled read or
+ * processing is dropped as soon as it's done. Load whose processing task is
+ * rejected by processing dispatcher is dropped too.
+ *
+ */
+class FileLoadPipeline {
+ public:
+  /**
+   * @brief Processing called on processing dispatcher with read error or
+   * file content.
+   *
+   */
+  using ProcessCallback =
+      std::function<void(std::error_code error, std::vector<std::byte> data)>;
+
+  /**
+   * @param options Pipeline limits.
+   * @param file_reader Reader of read stage.
+   * @param processing_dispatcher Dispatcher of processing stage, e.g. thread
+   * pool with a worker per core.
+   */
+  FileLoadPipeline(FileLoadPipelineOptions options,
+                   std::shared_ptr<FileReader> file_reader,
+                   std::shared_ptr<DispatchTask> processing_dispatcher);
+
+  FileLoadPipeline(const FileLoadPipeline&) = delete;
+  FileLoadPipeline& operator=(const FileLoadPipeline&) = delete;
+
+  /**
+   * @brief Queue file load.
+   *
+   * @param path File path.
+   * @param process Processing of file content.
+   * @param priority Read and processing priority.
+   * @param location Caller location reported by read and processing tasks.
+   * @return Load handle.
+   */
+  TaskHandle Load(std::filesystem::path path, ProcessCallback process,
+                  TaskPriority priority,
+                  Location location = Location::Current());
+
+  /**
+   * @brief Cancel load which hasn't started processing yet.
+   *
+   * @param handle Load handle.
+   */
+  void CancelLoad(TaskHandle&& handle);
+
+  /**
+   * @brief Change priority of load waiting for read or processing.
+   *
+   * @param handle Load handle.
+   * @param priority New priority.
+   */
+  void UpdateLoadPriority(const TaskHandle& handle, TaskPriority priority);
+
+ private:
+  /**
+   * @brief Load stage.
+   *
+   */
+  enum class Stage {
+    kWaitingRead,
+    kReading,
+    kWaitingProcessing,
+    kProcessing,  ///< Processing task is posted.
+  };
+
+  /// Load ids of one priority in waiting order.
+  using StageLane = std::list<std::uint32_t>;
+
+  /**
+   * @brief File load.
+   *
+   */
+  struct Request {
+    std::filesystem::path path;
+    ProcessCallback process;
+    TaskPriority priority{TaskPriority::kUserVisible};
+    Location location;
+    Stage stage{Stage::kWaitingRead};
+    /// Place in stage lane while load waits for read or processing.
+    StageLane::iterator lane_position;
+
+    std::error_code error;
+    std::vector<std::byte> data;
+  };
+
+  /**
+   * @brief Loads waiting for one stage split by priority.
+   *
+   * Loads are removed or moved to another lane in O(1) by their position.
+   *
+   */
+  struct StageQueue {
+    std::array<StageLane, kTaskPrioritiesCount> lanes;
+    LaneSelector selector;
+  };
+
+  /**
+   * @brief Pipeline data shared with reads and processing tasks.
+   *
+   */
+  struct State {
+    FileLoadPipelineOptions options;
+    std::shared_ptr<FileReader> file_reader;
+    std::shared_ptr<DispatchTask> processing_dispatcher;
+    const std::uint32_t owner{TaskHandle::MakeOwner()};  ///< Handles issuer.
+
+    std::mutex guard;
+    std::unordered_map<std::uint32_t, Request> requests;
+    StageQueue waiting_reads;
+    StageQueue waiting_processing;
+
+    /// Reads submitted and not completed, cancelled ones included.
+    std::size_t reads_count{0};
+    /// Read files in waiting_processing.
+    std::size_t queued_files_count{0};
+    /// Processing tasks posted and not finished, cancelled ones included.
+    std::size_t processing_count{0};
+
+    std::uint32_t last_id{0};
+  };
+
+  // Called under state guard.
+  static StageQueue* GetStageQueueLocked(State& state, Stage stage);
+  static void PushRequestLocked(State& state, std::uint32_t id,
+                                Request& request, Stage stage);
+  static void RemoveRequestLocked(State& state, Request& request);
+  static std::uint32_t PopRequestLocked(StageQueue& queue);
+
+  /**
+   * @brief Start reads and processing which fit limits.
+   *
+   */
+  static void Advance(const std::shared_ptr<State>& state);
+  static void OnRead(const std::shared_ptr<State>& state, std::uint32_t id,
+                     std::error_code error, std::vector<std::byte> data);
+  static void RunProcessing(const std::shared_ptr<State>& state,
+                            std::uint32_t id);
+
+  /**
+   * @brief Drop loads whose processing was rejected by dispatcher, like
+   * cancelled ones.
+   *
+   */
+  static void DropProcessing(const std::shared_ptr<State>& state,
+                             const std::vector<std::uint32_t>& ids);
+
+  std::shared_ptr<State> state_;
+};
+}  // namespace mk
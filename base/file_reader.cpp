@@ -0,0 +1,26 @@
+#include "file_reader.h"
+
+#include <iostream>
+
+#include "dispatch_task.h"
+#include "metrics.h"
+
+namespace mk {
+void FileReader::PostReply(DispatchTask& reply_dispatcher,
+                           UniqueTask reply_task, TaskPriority priority) {
+  static auto& dropped_replies_counter = MetricsRegistry::Get().GetCounter(
+      "mk_file_read_replies_dropped_total",
+      "Read callbacks rejected by reply dispatcher.");
+
+  const auto location = reply_task.GetLocation();
+  if (reply_dispatcher.PostTask(std::move(reply_task), priority).IsIssued()) {
+    return;
+  }
+
+  // Callback has been destroyed with rejected task.
+  dropped_replies_counter.Increment();
+  std::cerr << "Reply of file read requested from "
+            << (location.file ? location.file : "unknown") << ":"
+            << location.line << " has been rejected" << std::endl;
+}
+}  // namespace mk
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "location.h"
+#include "task_priority.h"
+#include "unique_task.h"
+
+namespace mk {
+class DispatchTask;
+
+/**
+ * @brief Asynchronous file reading interface.
+ *
+ * Reads run in background and many of them may be in flight at once.
+ * Completion callback is posted to reply dispatcher. Read and callback tasks
+ * report caller location. If reply dispatcher rejects callback task, e.g.
+ * bounded loop with kReject policy or cancelled task group, callback is
+ * dropped, and rejected reply is logged and counted.
+ *
+ */
+class FileReader {
+ public:
+  using ReadCallback =
+      std::function<void(std::error_code error, std::size_t read_size)>;
+  using ReadFileCallback =
+      std::function<void(std::error_code error, std::vector<std::byte> data)>;
+
+  virtual ~FileReader() = default;
+
+  /**
+   * @brief Read whole file.
+   *
+   * @param path File path.
+   * @param reply_dispatcher Dispatcher to run callback on.
+   * @param callback Callback accepting file content.
+   * @param priority Callback task priority.
+   * @param location Caller location.
+   */
+  virtual void ReadFile(std::filesystem::path path,
+                        std::shared_ptr<DispatchTask> reply_dispatcher,
+                        ReadFileCallback callback, TaskPriority priority,
+                        Location location = Location::Current()) = 0;
+
+  /**
+   * @brief Read file range into caller buffer.
+   *
+   * Buffer must stay alive until callback is called. Read size is less than
+   * buffer size only if file ends before.
+   *
+   * @param path File path.
+   * @param offset Range offset in file.
+   * @param buffer Range buffer.
+   * @param size Range size.
+   * @param reply_dispatcher Dispatcher to run callback on.
+   * @param callback Callback accepting read size.
+   * @param priority Callback task priority.
+   * @param location Caller location.
+   */
+  virtual void ReadFileRange(std::filesystem::path path, std::uint64_t offset,
+                             std::byte* buffer, std::size_t size,
+                             std::shared_ptr<DispatchTask> reply_dispatcher,
+                             ReadCallback callback, TaskPriority priority,
+                             Location location = Location::Current()) = 0;
+
+ protected:
+  /**
+   * @brief Post callback task to reply dispatcher, report it if rejected.
+   *
+   * @param reply_dispatcher Dispatcher to run callback on.
+   * @param reply_task Task calling callback.
+   * @param priority Callback task priority.
+   */
+  static void PostReply(DispatchTask& reply_dispatcher, UniqueTask reply_task,
+                        TaskPriority priority);
+};
+}  // namespace mk
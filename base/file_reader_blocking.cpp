@@ -0,0 +1,103 @@
+#include "file_reader_blocking.h"
+
+#include <cerrno>
+#include <fstream>
+
+#include "dispatch_task.h"
+#include "metrics.h"
+
+namespace mk {
+namespace {
+std::error_code ReadRange(const std::filesystem::path& path,
+                          std::uint64_t offset, std::byte* buffer,
+                          std::size_t size, std::size_t& read_size) {
+  read_size = 0;
+
+  // File stream keeps errno of failed open.
+  errno = 0;
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    return errno != 0 ? std::error_code{errno, std::generic_category()}
+                      : std::make_error_code(std::errc::io_error);
+  }
+
+  if (!file.seekg(static_cast<std::streamoff>(offset))) {
+    return std::make_error_code(std::errc::io_error);
+  }
+
+  file.read(reinterpret_cast<char*>(buffer),
+            static_cast<std::streamsize>(size));
+  if (file.bad()) {
+    return std::make_error_code(std::errc::io_error);
+  }
+
+  read_size = static_cast<std::size_t>(file.gcount());
+  return {};
+}
+}  // namespace
+
+FileReaderBlocking::FileReaderBlocking(
+    std::shared_ptr<DispatchTask> blocking_dispatcher)
+    : blocking_dispatcher_{std::move(blocking_dispatcher)},
+      read_bytes_counter_{&MetricsRegistry::Get().GetCounter(
+          "mk_file_read_bytes_total", "Bytes read from files.",
+          {{"reader", "blocking"}})} {}
+
+void FileReaderBlocking::ReadFile(
+    std::filesystem::path path, std::shared_ptr<DispatchTask> reply_dispatcher,
+    ReadFileCallback callback, TaskPriority priority, Location location) {
+  blocking_dispatcher_->PostTask(
+      Task{[path = std::move(path),
+            reply_dispatcher = std::move(reply_dispatcher),
+            callback = std::move(callback), priority, location,
+            read_bytes_counter = read_bytes_counter_]() mutable {
+             std::vector<std::byte> data;
+             std::size_t read_size = 0;
+
+             std::error_code error;
+             const auto file_size = std::filesystem::file_size(path, error);
+             if (!error) {
+               data.resize(static_cast<std::size_t>(file_size));
+               error =
+                   ReadRange(path, 0, data.data(), data.size(), read_size);
+               // File may have been truncated since size was taken.
+               data.resize(read_size);
+             }
+             read_bytes_counter->Increment(read_size);
+
+             Task reply_task{[callback = std::move(callback), error,
+                              data = std::move(data)]() mutable {
+                               callback(error, std::move(data));
+                             },
+                             location};
+             PostReply(*reply_dispatcher, std::move(reply_task), priority);
+           },
+           location},
+      priority);
+}
+
+void FileReaderBlocking::ReadFileRange(
+    std::filesystem::path path, std::uint64_t offset, std::byte* buffer,
+    std::size_t size, std::shared_ptr<DispatchTask> reply_dispatcher,
+    ReadCallback callback, TaskPriority priority, Location location) {
+  blocking_dispatcher_->PostTask(
+      Task{[path = std::move(path), offset, buffer, size,
+            reply_dispatcher = std::move(reply_dispatcher),
+            callback = std::move(callback), priority, location,
+            read_bytes_counter = read_bytes_counter_]() mutable {
+             std::size_t read_size = 0;
+             const auto error =
+                 ReadRange(path, offset, buffer, size, read_size);
+             read_bytes_counter->Increment(read_size);
+
+             Task reply_task{
+                 [callback = std::move(callback), error, read_size]() {
+                   callback(error, read_size);
+                 },
+                 location};
+             PostReply(*reply_dispatcher, std::move(reply_task), priority);
+           },
+           location},
+      priority);
+}
+}  // namespace mk
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "file_reader.h"
+
+namespace mk {
+class Counter;
+
+/**
+ * @brief Reads files by blocking calls on given dispatcher.
+ *
+ * Portable fallback. Every read occupies dispatcher thread until it is done,
+ * so amount of reads in flight is limited by dispatcher threads.
+ *
+ */
+class FileReaderBlocking : public FileReader {
+ public:
+  /**
+   * @param blocking_dispatcher Dispatcher allowed to block, e.g. thread pool.
+   */
+  explicit FileReaderBlocking(
+      std::shared_ptr<DispatchTask> blocking_dispatcher);
+
+  /** @see FileReader. */
+  void ReadFile(std::filesystem::path path,
+                std::shared_ptr<DispatchTask> reply_dispatcher,
+                ReadFileCallback callback, TaskPriority priority,
+                Location location = Location::Current()) override;
+
+  /** @see FileReader. */
+  void ReadFileRange(std::filesystem::path path, std::uint64_t offset,
+                     std::byte* buffer, std::size_t size,
+                     std::shared_ptr<DispatchTask> reply_dispatcher,
+                     ReadCallback callback, TaskPriority priority,
+                     Location location = Location::Current()) override;
+
+ private:
+  std::shared_ptr<DispatchTask> blocking_dispatcher_;
+  /// Registry series outlive reader, tasks keep pointer.
+  Counter* read_bytes_counter_;
+};
+}  // namespace mk
@@ -0,0 +1,498 @@
+#include "file_reader_io_uring.h"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <vector>
+
+#include "dispatch_task.h"
+#include "metrics.h"
+#include "task_pump_epoll.h"
+
+namespace mk {
+namespace {
+constexpr unsigned kRingEntriesCount = 256;
+
+// Longer reads are split, kernel caps single read anyway.
+constexpr std::size_t kMaxReadSize = 1u << 30;
+
+int IoUringSetup(unsigned entries, io_uring_params& params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int IoUringEnter(int fd, unsigned to_submit, unsigned min_complete,
+                 unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+int IoUringRegister(int fd, unsigned opcode, void* arg, unsigned args_count) {
+  return static_cast<int>(
+      syscall(__NR_io_uring_register, fd, opcode, arg, args_count));
+}
+
+template <typename T>
+T* RingField(void* ring, std::uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+bool IsOpSupported(const io_uring_probe& probe, unsigned op) {
+  return op <= probe.last_op &&
+         (probe.ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+}  // namespace
+
+/**
+ * @brief Memory mapped submission and completion rings.
+ *
+ */
+struct FileReaderIoUring::Ring {
+  ~Ring() {
+    if (sqes != nullptr) {
+      munmap(sqes, sqes_size);
+    }
+    if (cq_ptr != nullptr && cq_ptr != sq_ptr) {
+      munmap(cq_ptr, cq_size);
+    }
+    if (sq_ptr != nullptr) {
+      munmap(sq_ptr, sq_size);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (event_fd >= 0) {
+      close(event_fd);
+    }
+  }
+
+  /**
+   * @brief Create ring if kernel supports all needed operations.
+   *
+   * @return Ring in success. Otherwise nullptr.
+   */
+  static std::unique_ptr<Ring> Create();
+
+  int fd{-1};
+  int event_fd{-1};  ///< Signalled on every completion.
+  unsigned sq_entries{0};
+  unsigned cq_entries{0};
+
+  void* sq_ptr{nullptr};
+  std::size_t sq_size{0};
+  void* cq_ptr{nullptr};
+  std::size_t cq_size{0};
+  io_uring_sqe* sqes{nullptr};
+  std::size_t sqes_size{0};
+
+  unsigned* sq_head{nullptr};
+  unsigned* sq_tail{nullptr};
+  unsigned* sq_mask{nullptr};
+  unsigned* sq_array{nullptr};
+
+  unsigned* cq_head{nullptr};
+  unsigned* cq_tail{nullptr};
+  unsigned* cq_mask{nullptr};
+  io_uring_cqe* cqes{nullptr};
+};
+
+std::unique_ptr<FileReaderIoUring::Ring> FileReaderIoUring::Ring::Create() {
+  auto ring = std::make_unique<Ring>();
+
+  io_uring_params params{};
+  ring->fd = IoUringSetup(kRingEntriesCount, params);
+  if (ring->fd < 0) {
+    return nullptr;
+  }
+
+  std::vector<char> probe_storage(
+      sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+  auto* probe = reinterpret_cast<io_uring_probe*>(probe_storage.data());
+  if (IoUringRegister(ring->fd, IORING_REGISTER_PROBE, probe, 256) < 0 ||
+      !IsOpSupported(*probe, IORING_OP_OPENAT) ||
+      !IsOpSupported(*probe, IORING_OP_READ)) {
+    return nullptr;
+  }
+
+  ring->sq_entries = params.sq_entries;
+  ring->cq_entries = params.cq_entries;
+  ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+  const auto is_single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (is_single_mmap) {
+    ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+  }
+
+  auto* sq_ptr = mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (sq_ptr == MAP_FAILED) {
+    return nullptr;
+  }
+  ring->sq_ptr = sq_ptr;
+
+  if (is_single_mmap) {
+    ring->cq_ptr = sq_ptr;
+  } else {
+    auto* cq_ptr =
+        mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED) {
+      return nullptr;
+    }
+    ring->cq_ptr = cq_ptr;
+  }
+
+  ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  auto* sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return nullptr;
+  }
+  ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+  ring->sq_head = RingField<unsigned>(ring->sq_ptr, params.sq_off.head);
+  ring->sq_tail = RingField<unsigned>(ring->sq_ptr, params.sq_off.tail);
+  ring->sq_mask = RingField<unsigned>(ring->sq_ptr, params.sq_off.ring_mask);
+  ring->sq_array = RingField<unsigned>(ring->sq_ptr, params.sq_off.array);
+
+  ring->cq_head = RingField<unsigned>(ring->cq_ptr, params.cq_off.head);
+  ring->cq_tail = RingField<unsigned>(ring->cq_ptr, params.cq_off.tail);
+  ring->cq_mask = RingField<unsigned>(ring->cq_ptr, params.cq_off.ring_mask);
+  ring->cqes = RingField<io_uring_cqe>(ring->cq_ptr, params.cq_off.cqes);
+
+  ring->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (ring->event_fd < 0 ||
+      IoUringRegister(ring->fd, IORING_REGISTER_EVENTFD, &ring->event_fd, 1) <
+          0) {
+    return nullptr;
+  }
+
+  return ring;
+}
+
+/**
+ * @brief Read state. Passed to kernel as submission user data.
+ *
+ */
+struct FileReaderIoUring::Operation {
+  enum class Stage {
+    kOpen,  ///< File is being opened.
+    kRead,  ///< Range is being read, maybe by several requests.
+  };
+
+  Stage stage{Stage::kOpen};
+  std::filesystem::path path;
+  int fd{-1};
+
+  std::uint64_t offset{0};
+  std::byte* buffer{nullptr};
+  std::size_t size{0};
+  std::size_t read_size{0};
+
+  /// Buffer is allocated by file size once file is opened.
+  bool is_whole_file{false};
+  std::vector<std::byte> data;
+
+  std::error_code error;
+  std::shared_ptr<DispatchTask> reply_dispatcher;
+  TaskPriority priority{TaskPriority::kUserVisible};
+  Location location;  ///< Caller location reported by reply task.
+  ReadCallback read_callback;
+  ReadFileCallback read_file_callback;
+};
+
+FileReaderIoUring::FileReaderIoUring(
+    std::shared_ptr<DispatchTask> fallback_dispatcher,
+    std::shared_ptr<TaskPumpEpoll> completion_pump)
+    : fallback_{std::move(fallback_dispatcher)},
+      ring_{Ring::Create()},
+      completion_pump_{std::move(completion_pump)},
+      read_bytes_counter_{MetricsRegistry::Get().GetCounter(
+          "mk_file_read_bytes_total", "Bytes read from files.",
+          {{"reader", "io_uring"}})},
+      in_flight_count_{0} {
+  if (!ring_) {
+    return;
+  }
+
+  const auto error = completion_pump_->WatchFileDescriptor(
+      ring_->event_fd, TaskPumpEpoll::kReadable, [this](int fd, unsigned) {
+        // Completions posted after drain signal eventfd again.
+        std::uint64_t value = 0;
+        [[maybe_unused]] const auto result = read(fd, &value, sizeof(value));
+        ReapCompletions();
+      });
+  if (error) {
+    ring_.reset();
+  }
+}
+
+FileReaderIoUring::~FileReaderIoUring() {
+  if (!ring_) {
+    return;
+  }
+
+  // Reads in flight are reaped here once pump doesn't watch them.
+  completion_pump_->UnwatchFileDescriptor(ring_->event_fd);
+
+  while (true) {
+    {
+      std::lock_guard lock{submit_guard_};
+      // Backlog is flushed by completion, so it waits only for reads in
+      // flight.
+      if (in_flight_count_ == 0) {
+        break;
+      }
+    }
+
+    // Interrupted wait just reaps nothing.
+    IoUringEnter(ring_->fd, 0, 1, IORING_ENTER_GETEVENTS);
+    ReapCompletions();
+  }
+}
+
+bool FileReaderIoUring::IsAsync() const { return ring_ != nullptr; }
+
+void FileReaderIoUring::ReadFile(std::filesystem::path path,
+                                 std::shared_ptr<DispatchTask> reply_dispatcher,
+                                 ReadFileCallback callback,
+                                 TaskPriority priority, Location location) {
+  if (!ring_) {
+    fallback_.ReadFile(std::move(path), std::move(reply_dispatcher),
+                       std::move(callback), priority, location);
+    return;
+  }
+
+  auto operation = std::make_unique<Operation>();
+  operation->path = std::move(path);
+  operation->is_whole_file = true;
+  operation->reply_dispatcher = std::move(reply_dispatcher);
+  operation->priority = priority;
+  operation->location = location;
+  operation->read_file_callback = std::move(callback);
+
+  Submit(std::move(operation));
+}
+
+void FileReaderIoUring::ReadFileRange(
+    std::filesystem::path path, std::uint64_t offset, std::byte* buffer,
+    std::size_t size, std::shared_ptr<DispatchTask> reply_dispatcher,
+    ReadCallback callback, TaskPriority priority, Location location) {
+  if (!ring_) {
+    fallback_.ReadFileRange(std::move(path), offset, buffer, size,
+                            std::move(reply_dispatcher), std::move(callback),
+                            priority, location);
+    return;
+  }
+
+  auto operation = std::make_unique<Operation>();
+  operation->path = std::move(path);
+  operation->offset = offset;
+  operation->buffer = buffer;
+  operation->size = size;
+  operation->reply_dispatcher = std::move(reply_dispatcher);
+  operation->priority = priority;
+  operation->location = location;
+  operation->read_callback = std::move(callback);
+
+  Submit(std::move(operation));
+}
+
+void FileReaderIoUring::Submit(std::unique_ptr<Operation> operation) {
+  {
+    std::lock_guard lock{submit_guard_};
+    if (const auto error = SubmitLocked(operation.get()); error) {
+      operation->error = error;
+    } else {
+      operation.release();
+    }
+  }
+
+  // Reply is posted out of lock.
+  if (operation) {
+    Complete(std::move(operation));
+  }
+}
+
+std::error_code FileReaderIoUring::SubmitLocked(Operation* operation) {
+  const auto tail = *ring_->sq_tail;
+  const auto head = __atomic_load_n(ring_->sq_head, __ATOMIC_ACQUIRE);
+
+  // Keep completions within completion ring, so none of them is dropped.
+  if (!backlog_.empty() || tail - head == ring_->sq_entries ||
+      in_flight_count_ == ring_->cq_entries) {
+    backlog_.push_back(operation);
+    return {};
+  }
+
+  const auto index = tail & *ring_->sq_mask;
+  auto& sqe = ring_->sqes[index];
+  sqe = io_uring_sqe{};
+  sqe.user_data = reinterpret_cast<std::uint64_t>(operation);
+
+  if (operation->stage == Operation::Stage::kOpen) {
+    sqe.opcode = IORING_OP_OPENAT;
+    sqe.fd = AT_FDCWD;
+    sqe.addr = reinterpret_cast<std::uint64_t>(operation->path.c_str());
+    sqe.open_flags = O_RDONLY | O_CLOEXEC;
+  } else {
+    const auto left_size =
+        std::min(operation->size - operation->read_size, kMaxReadSize);
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = operation->fd;
+    auto* const buffer = operation->buffer + operation->read_size;
+    sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+    sqe.len = static_cast<std::uint32_t>(left_size);
+    sqe.off = operation->offset + operation->read_size;
+  }
+
+  ring_->sq_array[index] = index;
+  __atomic_store_n(ring_->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  auto result = IoUringEnter(ring_->fd, 1, 0, 0);
+  while (result < 0 && errno == EINTR) {
+    result = IoUringEnter(ring_->fd, 1, 0, 0);
+  }
+
+  if (result < 0) {
+    // Entries are submitted under lock only, so kernel hasn't taken it.
+    const std::error_code error{errno, std::generic_category()};
+    __atomic_store_n(ring_->sq_tail, tail, __ATOMIC_RELEASE);
+    return error;
+  }
+
+  ++in_flight_count_;
+  return {};
+}
+
+void FileReaderIoUring::FlushBacklogLocked(
+    std::vector<std::unique_ptr<Operation>>& failed_operations) {
+  auto backlog = std::move(backlog_);
+  backlog_.clear();
+
+  for (auto* operation : backlog) {
+    if (const auto error = SubmitLocked(operation); error) {
+      operation->error = error;
+      failed_operations.emplace_back(operation);
+    }
+  }
+}
+
+void FileReaderIoUring::ReapCompletions() {
+  // Copy completions out, so ring space is freed before handling.
+  std::vector<io_uring_cqe> completions;
+  auto head = *ring_->cq_head;
+  const auto tail = __atomic_load_n(ring_->cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head) {
+    completions.push_back(ring_->cqes[head & *ring_->cq_mask]);
+  }
+  __atomic_store_n(ring_->cq_head, head, __ATOMIC_RELEASE);
+
+  for (const auto& completion : completions) {
+    {
+      std::lock_guard lock{submit_guard_};
+      --in_flight_count_;
+    }
+    OnCompletion(reinterpret_cast<Operation*>(completion.user_data),
+                 completion.res);
+  }
+
+  std::vector<std::unique_ptr<Operation>> failed_operations;
+  {
+    std::lock_guard lock{submit_guard_};
+    FlushBacklogLocked(failed_operations);
+  }
+
+  for (auto& operation : failed_operations) {
+    Complete(std::move(operation));
+  }
+}
+
+void FileReaderIoUring::OnCompletion(Operation* operation, int result) {
+  if (result == -EINTR || result == -EAGAIN) {
+    Submit(std::unique_ptr<Operation>{operation});
+    return;
+  }
+
+  std::unique_ptr<Operation> owned_operation{operation};
+  if (result < 0) {
+    operation->error = std::error_code{-result, std::generic_category()};
+    Complete(std::move(owned_operation));
+    return;
+  }
+
+  if (operation->stage == Operation::Stage::kOpen) {
+    operation->fd = result;
+    operation->stage = Operation::Stage::kRead;
+
+    if (operation->is_whole_file) {
+      struct stat file_stat {};
+      if (fstat(operation->fd, &file_stat) < 0) {
+        operation->error = std::error_code{errno, std::generic_category()};
+        Complete(std::move(owned_operation));
+        return;
+      }
+
+      operation->data.resize(static_cast<std::size_t>(file_stat.st_size));
+      operation->buffer = operation->data.data();
+      operation->size = operation->data.size();
+    }
+  } else {
+    operation->read_size += static_cast<std::size_t>(result);
+
+    // Zero read is end of file.
+    if (result == 0) {
+      Complete(std::move(owned_operation));
+      return;
+    }
+  }
+
+  if (operation->read_size == operation->size) {
+    Complete(std::move(owned_operation));
+    return;
+  }
+
+  Submit(std::move(owned_operation));
+}
+
+void FileReaderIoUring::Complete(std::unique_ptr<Operation> operation) {
+  if (operation->fd >= 0) {
+    close(operation->fd);
+  }
+
+  read_bytes_counter_.Increment(operation->read_size);
+
+  auto& reply_dispatcher = *operation->reply_dispatcher;
+  const auto priority = operation->priority;
+
+  if (operation->is_whole_file) {
+    operation->data.resize(operation->read_size);
+    PostReply(reply_dispatcher,
+              Task{[callback = std::move(operation->read_file_callback),
+                    error = operation->error,
+                    data = std::move(operation->data)]() mutable {
+                     callback(error, std::move(data));
+                   },
+                   operation->location},
+              priority);
+  } else {
+    PostReply(reply_dispatcher,
+              Task{[callback = std::move(operation->read_callback),
+                    error = operation->error,
+                    read_size = operation->read_size]() {
+                     callback(error, read_size);
+                   },
+                   operation->location},
+              priority);
+  }
+}
+}  // namespace mk
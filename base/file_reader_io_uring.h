@@ -0,0 +1,88 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "file_reader.h"
+#include "file_reader_blocking.h"
+
+namespace mk {
+class TaskPumpEpoll;
+
+/**
+ * @brief Reads files by Linux io_uring.
+ *
+ * Open and read requests of all reads are submitted to one ring, so many
+ * reads are in flight without blocking any thread. Ring signals completions
+ * to eventfd watched by completion pump, and they are handled on thread
+ * which waits in the pump, e.g. idle worker of filesystem pool. If io_uring
+ * is not available, reads fall back to FileReaderBlocking.
+ *
+ */
+class FileReaderIoUring : public FileReader {
+ public:
+  /**
+   * @param fallback_dispatcher Dispatcher for blocking fallback reads.
+   * @param completion_pump Pump to watch completions by.
+   */
+  FileReaderIoUring(std::shared_ptr<DispatchTask> fallback_dispatcher,
+                    std::shared_ptr<TaskPumpEpoll> completion_pump);
+
+  /**
+   * @brief Stop watching completions and wait for reads in flight.
+   *
+   */
+  ~FileReaderIoUring() override;
+
+  FileReaderIoUring(const FileReaderIoUring&) = delete;
+  FileReaderIoUring& operator=(const FileReaderIoUring&) = delete;
+
+  /**
+   * @brief Tell if reads go through io_uring.
+   *
+   */
+  bool IsAsync() const;
+
+  /** @see FileReader. */
+  void ReadFile(std::filesystem::path path,
+                std::shared_ptr<DispatchTask> reply_dispatcher,
+                ReadFileCallback callback, TaskPriority priority,
+                Location location = Location::Current()) override;
+
+  /** @see FileReader. */
+  void ReadFileRange(std::filesystem::path path, std::uint64_t offset,
+                     std::byte* buffer, std::size_t size,
+                     std::shared_ptr<DispatchTask> reply_dispatcher,
+                     ReadCallback callback, TaskPriority priority,
+                     Location location = Location::Current()) override;
+
+ private:
+  struct Ring;
+  struct Operation;
+
+  void Submit(std::unique_ptr<Operation> operation);
+  std::error_code SubmitLocked(Operation* operation);
+  void FlushBacklogLocked(
+      std::vector<std::unique_ptr<Operation>>& failed_operations);
+
+  /**
+   * @brief Handle completions posted to ring. Called by one thread at once.
+   *
+   */
+  void ReapCompletions();
+  void OnCompletion(Operation* operation, int result);
+  void Complete(std::unique_ptr<Operation> operation);
+
+  FileReaderBlocking fallback_;
+  std::unique_ptr<Ring> ring_;
+  std::shared_ptr<TaskPumpEpoll> completion_pump_;
+  Counter& read_bytes_counter_;
+
+  std::mutex submit_guard_;
+  std::deque<Operation*> backlog_;
+  std::size_t in_flight_count_;
+};
+}  // namespace mk
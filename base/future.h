@@ -0,0 +1,151 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "dispatch_task.h"
+#include "location.h"
+
+namespace mk {
+namespace internal {
+/**
+ * @brief Value and continuation shared by Promise and Future.
+ *
+ */
+template <typename T>
+struct FutureState {
+  /**
+   * @brief Callback waiting for value.
+   *
+   */
+  struct Continuation {
+    virtual ~Continuation() = default;
+
+    /**
+     * @brief Post callback with value to its dispatcher.
+     *
+     */
+    virtual void Post(T value) = 0;
+  };
+
+  std::mutex guard;
+  std::optional<T> value;
+  std::unique_ptr<Continuation> continuation;
+};
+}  // namespace internal
+
+template <typename T>
+class Future;
+
+/**
+ * @brief Write side of one-shot value channel.
+ *
+ * If promise is destroyed without value, continuation is never called.
+ *
+ */
+template <typename T>
+class Promise {
+ public:
+  Promise() : state_{std::make_shared<internal::FutureState<T>>()} {}
+
+  /**
+   * @brief Get read side. Must be called once.
+   *
+   */
+  Future<T> GetFuture() const { return Future<T>{state_}; }
+
+  /**
+   * @brief Set value and post continuation if it is already attached.
+   *
+   * @param value Result value.
+   */
+  void SetValue(T value) {
+    std::unique_lock lock{state_->guard};
+    if (!state_->continuation) {
+      state_->value.emplace(std::move(value));
+      return;
+    }
+
+    auto continuation = std::move(state_->continuation);
+    lock.unlock();
+    continuation->Post(std::move(value));
+  }
+
+ private:
+  std::shared_ptr<internal::FutureState<T>> state_;
+};
+
+/**
+ * @brief Read side of one-shot value channel.
+ *
+ * Value is never waited for. Continuation is posted to given dispatcher when
+ * value is ready.
+ *
+ */
+template <typename T>
+class Future {
+ public:
+  /**
+   * @brief Attach continuation. Must be called once.
+   *
+   * @param dispatcher Dispatcher to run callback on.
+   * @param callback Callable accepting value.
+   * @param priority Callback task priority.
+   * @param location Caller location reported for callback task.
+   */
+  template <typename Callback>
+  void Then(std::shared_ptr<DispatchTask> dispatcher, Callback callback,
+            TaskPriority priority = TaskPriority::kUserVisible,
+            Location location = Location::Current()) {
+    auto continuation = std::make_unique<Continuation<Callback>>(
+        std::move(dispatcher), std::move(callback), priority, location);
+
+    std::unique_lock lock{state_->guard};
+    if (!state_->value) {
+      state_->continuation = std::move(continuation);
+      return;
+    }
+
+    auto value = std::move(*state_->value);
+    state_->value.reset();
+    lock.unlock();
+    continuation->Post(std::move(value));
+  }
+
+ private:
+  friend class Promise<T>;
+
+  template <typename Callback>
+  class Continuation : public internal::FutureState<T>::Continuation {
+   public:
+    Continuation(std::shared_ptr<DispatchTask> dispatcher, Callback callback,
+                 TaskPriority priority, Location location)
+        : dispatcher_{std::move(dispatcher)},
+          callback_{std::move(callback)},
+          priority_{priority},
+          location_{location} {}
+
+    void Post(T value) override {
+      dispatcher_->PostTask(Task{[callback = std::move(callback_),
+                                  value = std::move(value)]() mutable {
+                                   callback(std::move(value));
+                                 },
+                                 location_},
+                            priority_);
+    }
+
+   private:
+    std::shared_ptr<DispatchTask> dispatcher_;
+    Callback callback_;
+    TaskPriority priority_;
+    Location location_;
+  };
+
+  explicit Future(std::shared_ptr<internal::FutureState<T>> state)
+      : state_{std::move(state)} {}
+
+  std::shared_ptr<internal::FutureState<T>> state_;
+};
+}  // namespace mk
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace mk {
+/**
+ * @brief Source code location.
+ *
+ * Current() used as default argument captures location of the caller.
+ *
+ */
+struct Location {
+  static constexpr Location Current(const char* file = __builtin_FILE(),
+                                    int line = __builtin_LINE()) {
+    return Location{file, line};
+  }
+
+  const char* file{nullptr};
+  int line{0};
+};
+}  // namespace mk
@@ -0,0 +1,362 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+
+namespace mk {
+namespace {
+std::atomic<std::size_t> last_shard_index{0};
+
+std::size_t GetShardIndex() {
+  // Threads take shards round robin.
+  thread_local const std::size_t shard_index =
+      last_shard_index.fetch_add(1, std::memory_order_relaxed) %
+      kMetricShardsCount;
+  return shard_index;
+}
+
+std::size_t GetBitWidth(std::uint64_t value) {
+#if defined(__GNUC__)
+  return value == 0 ? 0 : 64 - static_cast<std::size_t>(__builtin_clzll(value));
+#else
+  std::size_t width = 0;
+  for (; value != 0; value >>= 1) {
+    ++width;
+  }
+
+  return width;
+#endif
+}
+
+const char* GetTypeName(MetricType type) {
+  switch (type) {
+    case MetricType::kCounter:
+      return "counter";
+    case MetricType::kGauge:
+      return "gauge";
+    case MetricType::kHistogram:
+      return "histogram";
+  }
+
+  return "untyped";
+}
+
+void WriteEscaped(std::ostream& stream, const std::string& string) {
+  for (const auto character : string) {
+    if (character == '\n') {
+      stream << "\\n";
+      continue;
+    }
+
+    if (character == '"' || character == '\\') {
+      stream << '\\';
+    }
+    stream << character;
+  }
+}
+
+/**
+ * @brief Write labels with optional extra label, e.g. histogram bucket "le".
+ *
+ */
+void WriteLabels(std::ostream& stream, const MetricLabels& labels,
+                 const char* extra_name = nullptr,
+                 const std::string& extra_value = {}) {
+  if (labels.empty() && extra_name == nullptr) {
+    return;
+  }
+
+  stream << '{';
+  bool is_first = true;
+  for (const auto& [name, value] : labels) {
+    stream << (is_first ? "" : ",") << name << "=\"";
+    WriteEscaped(stream, value);
+    stream << '"';
+    is_first = false;
+  }
+
+  if (extra_name != nullptr) {
+    stream << (is_first ? "" : ",") << extra_name << "=\"" << extra_value
+           << '"';
+  }
+  stream << '}';
+}
+}  // namespace
+
+Counter::Counter() = default;
+
+void Counter::Increment(std::uint64_t value) {
+  shards_[GetShardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::uint64_t Counter::GetValue() const {
+  std::uint64_t value = 0;
+  for (const auto& shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+
+  return value;
+}
+
+Gauge::Gauge() : value_{0} {}
+
+void Gauge::Set(std::int64_t value) {
+  value_.store(value, std::memory_order_relaxed);
+}
+
+void Gauge::Add(std::int64_t value) {
+  value_.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::int64_t Gauge::GetValue() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t HistogramSnapshot::GetPercentile(double ratio) const {
+  if (count == 0) {
+    return 0;
+  }
+
+  const auto rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(
+             std::ceil(ratio * static_cast<double>(count))));
+
+  std::uint64_t seen_count = 0;
+  for (const auto& bucket : buckets) {
+    seen_count += bucket.count;
+    if (seen_count >= rank) {
+      return bucket.upper_bound;
+    }
+  }
+
+  return buckets.empty() ? 0 : buckets.back().upper_bound;
+}
+
+Histogram::Histogram()
+    : shards_{std::make_unique<Shard[]>(kMetricShardsCount)} {}
+
+void Histogram::Record(std::uint64_t value) {
+  auto& shard = shards_[GetShardIndex()];
+  shard.buckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::GetSnapshot() const {
+  std::array<std::uint64_t, kHistogramBucketsCount> counts{};
+
+  HistogramSnapshot snapshot;
+  for (std::size_t i = 0; i < kMetricShardsCount; ++i) {
+    const auto& shard = shards_[i];
+    snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+    for (std::size_t bucket = 0; bucket < kHistogramBucketsCount; ++bucket) {
+      counts[bucket] += shard.buckets[bucket].load(std::memory_order_relaxed);
+    }
+  }
+
+  // Count is summed from buckets, so it matches them under concurrent
+  // recording.
+  for (std::size_t bucket = 0; bucket < kHistogramBucketsCount; ++bucket) {
+    if (counts[bucket] != 0) {
+      snapshot.count += counts[bucket];
+      snapshot.buckets.push_back(
+          HistogramBucket{GetBucketUpperBound(bucket), counts[bucket]});
+    }
+  }
+
+  return snapshot;
+}
+
+std::size_t Histogram::GetBucketIndex(std::uint64_t value) {
+  if (value < kHistogramSubBucketsCount) {
+    return static_cast<std::size_t>(value);
+  }
+
+  // Leading bit and kHistogramSubBucketBits bits after it select bucket.
+  const auto shift = GetBitWidth(value) - kHistogramSubBucketBits - 1;
+  const auto sub_bucket =
+      static_cast<std::size_t>(value >> shift) - kHistogramSubBucketsCount;
+
+  return (shift + 1) * kHistogramSubBucketsCount + sub_bucket;
+}
+
+std::uint64_t Histogram::GetBucketUpperBound(std::size_t index) {
+  if (index < kHistogramSubBucketsCount) {
+    return index;
+  }
+
+  const auto shift = index / kHistogramSubBucketsCount - 1;
+  const auto sub_bucket = index % kHistogramSubBucketsCount;
+  const auto lower_bound =
+      static_cast<std::uint64_t>(kHistogramSubBucketsCount + sub_bucket)
+      << shift;
+
+  return lower_bound + ((std::uint64_t{1} << shift) - 1);
+}
+
+MetricsRegistry& MetricsRegistry::Get() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::MetricsRegistry() = default;
+
+MetricsRegistry::~MetricsRegistry() = default;
+
+Counter& MetricsRegistry::GetCounter(const std::string& name,
+                                     const std::string& help,
+                                     const MetricLabels& labels) {
+  return *GetSeries(name, help, labels, MetricType::kCounter).counter;
+}
+
+Gauge& MetricsRegistry::GetGauge(const std::string& name,
+                                 const std::string& help,
+                                 const MetricLabels& labels) {
+  return *GetSeries(name, help, labels, MetricType::kGauge).gauge;
+}
+
+Histogram& MetricsRegistry::GetHistogram(const std::string& name,
+                                         const std::string& help,
+                                         const MetricLabels& labels) {
+  return *GetSeries(name, help, labels, MetricType::kHistogram).histogram;
+}
+
+std::vector<MetricSnapshot> MetricsRegistry::GetSnapshot() const {
+  std::vector<MetricSnapshot> snapshot;
+
+  std::lock_guard lock{guard_};
+  snapshot.reserve(series_.size());
+  for (const auto& [key, series] : series_) {
+    MetricSnapshot metric;
+    metric.name = series.name;
+    metric.help = series.help;
+    metric.labels = series.labels;
+    metric.type = series.type;
+
+    switch (series.type) {
+      case MetricType::kCounter:
+        metric.value = static_cast<std::int64_t>(series.counter->GetValue());
+        break;
+      case MetricType::kGauge:
+        metric.value = series.gauge->GetValue();
+        break;
+      case MetricType::kHistogram:
+        metric.histogram = series.histogram->GetSnapshot();
+        break;
+    }
+
+    snapshot.push_back(std::move(metric));
+  }
+
+  return snapshot;
+}
+
+void MetricsRegistry::WritePrometheus(std::ostream& stream) const {
+  const std::string* last_name = nullptr;
+
+  const auto snapshot = GetSnapshot();
+  for (const auto& metric : snapshot) {
+    // Series of one metric follow each other and share header.
+    if (last_name == nullptr || *last_name != metric.name) {
+      stream << "# HELP " << metric.name << ' ';
+      WriteEscaped(stream, metric.help);
+      stream << "\n# TYPE " << metric.name << ' ' << GetTypeName(metric.type)
+             << '\n';
+      last_name = &metric.name;
+    }
+
+    if (metric.type != MetricType::kHistogram) {
+      stream << metric.name;
+      WriteLabels(stream, metric.labels);
+      stream << ' ' << metric.value << '\n';
+      continue;
+    }
+
+    const auto& histogram = metric.histogram;
+    std::uint64_t cumulative_count = 0;
+    for (const auto& bucket : histogram.buckets) {
+      cumulative_count += bucket.count;
+      stream << metric.name << "_bucket";
+      WriteLabels(stream, metric.labels, "le",
+                  std::to_string(bucket.upper_bound));
+      stream << ' ' << cumulative_count << '\n';
+    }
+
+    stream << metric.name << "_bucket";
+    WriteLabels(stream, metric.labels, "le", "+Inf");
+    stream << ' ' << histogram.count << '\n';
+
+    stream << metric.name << "_sum";
+    WriteLabels(stream, metric.labels);
+    stream << ' ' << histogram.sum << '\n';
+
+    stream << metric.name << "_count";
+    WriteLabels(stream, metric.labels);
+    stream << ' ' << histogram.count << '\n';
+  }
+}
+
+std::error_code MetricsRegistry::WritePrometheusFile(
+    const std::filesystem::path& path) const {
+  auto temporary_path = path;
+  temporary_path += ".tmp";
+
+  std::lock_guard lock{file_guard_};
+  {
+    std::ofstream file{temporary_path, std::ios::trunc};
+    if (!file) {
+      return std::make_error_code(std::errc::io_error);
+    }
+
+    WritePrometheus(file);
+    file.flush();
+    if (!file) {
+      return std::make_error_code(std::errc::io_error);
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporary_path, path, error);
+
+  return error;
+}
+
+MetricsRegistry::Series& MetricsRegistry::GetSeries(const std::string& name,
+                                                    const std::string& help,
+                                                    const MetricLabels& labels,
+                                                    MetricType type) {
+  std::lock_guard lock{guard_};
+
+  auto [it, is_inserted] =
+      series_.try_emplace(std::make_pair(name, labels), Series{});
+  auto* series = &it->second;
+  if (!is_inserted) {
+    if (series->type == type) {
+      return *series;
+    }
+
+    // Caller still gets usable series, it just isn't exported.
+    assert(false && "Metric is registered with other type.");
+    series = detached_series_.emplace_back(std::make_unique<Series>()).get();
+  }
+
+  series->name = name;
+  series->help = help;
+  series->labels = labels;
+  series->type = type;
+  switch (type) {
+    case MetricType::kCounter:
+      series->counter = std::make_unique<Counter>();
+      break;
+    case MetricType::kGauge:
+      series->gauge = std::make_unique<Gauge>();
+      break;
+    case MetricType::kHistogram:
+      series->histogram = std::make_unique<Histogram>();
+      break;
+  }
+
+  return *series;
+}
+}  // namespace mk
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace mk {
+/// Shards of counters and histograms. Every thread updates own shard, so
+/// threads rarely share cache line.
+constexpr std::size_t kMetricShardsCount = 16;
+
+/// Histogram keeps 2^kHistogramSubBucketBits buckets per power of two, so
+/// recorded value is off by 1/8 of it at most.
+constexpr std::size_t kHistogramSubBucketBits = 3;
+constexpr std::size_t kHistogramSubBucketsCount = std::size_t{1}
+                                                  << kHistogramSubBucketBits;
+constexpr std::size_t kHistogramBucketsCount =
+    (64 - kHistogramSubBucketBits + 1) * kHistogramSubBucketsCount;
+
+/// Label name and value pairs in export order.
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+enum class MetricType {
+  kCounter,    ///< Monotonic total, e.g. tasks run.
+  kGauge,      ///< Current value, e.g. queue depth.
+  kHistogram,  ///< Value distribution, e.g. decode time.
+};
+
+/**
+ * @brief Monotonic counter.
+ *
+ */
+class Counter {
+ public:
+  Counter();
+
+  Counter(const Counter&) = delete;
+  Counter& operator=(const Counter&) = delete;
+
+  void Increment(std::uint64_t value = 1);
+  std::uint64_t GetValue() const;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<std::uint64_t> value{0};
+  };
+
+  std::array<Shard, kMetricShardsCount> shards_;
+};
+
+/**
+ * @brief Value which goes up and down.
+ *
+ * Gauge isn't sharded, it is expected to be set by one thread or changed
+ * rarely.
+ *
+ */
+class Gauge {
+ public:
+  Gauge();
+
+  Gauge(const Gauge&) = delete;
+  Gauge& operator=(const Gauge&) = delete;
+
+  void Set(std::int64_t value);
+  void Add(std::int64_t value);
+  std::int64_t GetValue() const;
+
+ private:
+  std::atomic<std::int64_t> value_;
+};
+
+/**
+ * @brief Histogram bucket with recorded values from previous bucket upper
+ * bound exclusive to own upper bound inclusive.
+ *
+ */
+struct HistogramBucket {
+  std::uint64_t upper_bound{0};
+  std::uint64_t count{0};
+};
+
+/**
+ * @brief Histogram state.
+ *
+ */
+struct HistogramSnapshot {
+  std::uint64_t count{0};
+  std::uint64_t sum{0};
+  std::vector<HistogramBucket> buckets;  ///< Non-empty buckets, ascending.
+
+  /**
+   * @brief Get upper bound of value not exceeded by given ratio of values.
+   *
+   * @param ratio Ratio from 0 to 1, e.g. 0.99.
+   * @return Bucket upper bound. Zero if histogram is empty.
+   */
+  std::uint64_t GetPercentile(double ratio) const;
+};
+
+/**
+ * @brief Distribution of integer values, e.g. durations in microseconds or
+ * sizes in bytes.
+ *
+ * Buckets are log-linear as in HdrHistogram: values below
+ * kHistogramSubBucketsCount are exact, every next power of two is split into
+ * kHistogramSubBucketsCount buckets. Recording is a couple of relaxed
+ * increments in thread shard.
+ *
+ */
+class Histogram {
+ public:
+  Histogram();
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void Record(std::uint64_t value);
+  HistogramSnapshot GetSnapshot() const;
+
+  static std::size_t GetBucketIndex(std::uint64_t value);
+  static std::uint64_t GetBucketUpperBound(std::size_t index);
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<std::uint64_t> sum{0};
+    std::array<std::atomic<std::uint64_t>, kHistogramBucketsCount> buckets{};
+  };
+
+  std::unique_ptr<Shard[]> shards_;
+};
+
+/**
+ * @brief State of one metric series.
+ *
+ */
+struct MetricSnapshot {
+  std::string name;
+  std::string help;
+  MetricLabels labels;
+  MetricType type{MetricType::kCounter};
+  std::int64_t value{0};        ///< Counter or gauge value.
+  HistogramSnapshot histogram;  ///< Histogram state.
+};
+
+/**
+ * @brief Named metrics of process.
+ *
+ * Metric series is identified by name and labels. Getting series creates it
+ * on the first call, series are never removed, so callers keep references
+ * and update them without registry lookup. Getting series registered with
+ * other type returns detached series which isn't exported.
+ *
+ */
+class MetricsRegistry {
+ public:
+  /**
+   * @brief Get process-wide registry.
+   *
+   */
+  static MetricsRegistry& Get();
+
+  MetricsRegistry();
+  ~MetricsRegistry();
+
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  Counter& GetCounter(const std::string& name, const std::string& help,
+                      const MetricLabels& labels = {});
+  Gauge& GetGauge(const std::string& name, const std::string& help,
+                  const MetricLabels& labels = {});
+  Histogram& GetHistogram(const std::string& name, const std::string& help,
+                          const MetricLabels& labels = {});
+
+  /**
+   * @brief Read all series ordered by name. May be called from any thread.
+   *
+   */
+  std::vector<MetricSnapshot> GetSnapshot() const;
+
+  /**
+   * @brief Write all series in Prometheus text exposition format.
+   *
+   * Histogram writes its non-empty buckets only.
+   *
+   * @param stream Output stream.
+   */
+  void WritePrometheus(std::ostream& stream) const;
+
+  /**
+   * @brief Replace file with Prometheus text atomically, so readers never see
+   * partial file. Concurrent writes of the same file are serialized.
+   *
+   * @param path File path.
+   * @return Error if file can't be written.
+   */
+  std::error_code WritePrometheusFile(const std::filesystem::path& path) const;
+
+ private:
+  /**
+   * @brief Metric series storage.
+   *
+   */
+  struct Series {
+    std::string name;
+    std::string help;
+    MetricLabels labels;
+    MetricType type{MetricType::kCounter};
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  Series& GetSeries(const std::string& name, const std::string& help,
+                    const MetricLabels& labels, MetricType type);
+
+  mutable std::mutex guard_;
+  /// Series by name and labels.
+  std::map<std::pair<std::string, MetricLabels>, Series> series_;
+  /// Series requested with other type than registered one.
+  std::vector<std::unique_ptr<Series>> detached_series_;
+
+  /// Writers share temporary file.
+  mutable std::mutex file_guard_;
+};
+}  // namespace mk
@@ -0,0 +1,41 @@
+#include "metrics_file_exporter.h"
+
+#include <iostream>
+#include <limits>
+
+#include "dispatch_task.h"
+#include "metrics.h"
+
+namespace mk {
+namespace {
+void Export(const MetricsRegistry& registry,
+            const std::filesystem::path& path) {
+  if (const auto error = registry.WritePrometheusFile(path)) {
+    std::cerr << "Can't write metrics to " << path << ": " << error.message()
+              << std::endl;
+  }
+}
+}  // namespace
+
+MetricsFileExporter::MetricsFileExporter(
+    MetricsRegistry& registry, MetricsFileExporterOptions options,
+    std::shared_ptr<DispatchTask> dispatcher)
+    : registry_{registry},
+      options_{std::move(options)},
+      dispatcher_{std::move(dispatcher)} {
+  // Task doesn't refer to exporter, it may run while exporter is destroyed.
+  // Export may be late, so it shares wakeup with other timers.
+  export_task_handle_ = dispatcher_->PostRepeatingTask(
+      [&registry = registry_, path = options_.path]() {
+        Export(registry, path);
+      },
+      std::numeric_limits<size_t>::max(), options_.period,
+      TaskPriority::kBackground,
+      TimerOptions{RepeatMode::kFixedDelay, options_.period / 10});
+}
+
+MetricsFileExporter::~MetricsFileExporter() {
+  dispatcher_->CancelTask(std::move(export_task_handle_));
+  Export(registry_, options_.path);
+}
+}  // namespace mk
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+
+#include "task_handle.h"
+#include "time_types.h"
+
+namespace mk {
+class DispatchTask;
+class MetricsRegistry;
+
+/**
+ * @brief Metrics file export configuration.
+ *
+ */
+struct MetricsFileExporterOptions {
+  /// File replaced with Prometheus text on every export, e.g. for
+  /// node_exporter textfile collector.
+  std::filesystem::path path{"mocker_metrics.prom"};
+
+  /// Delay between exports.
+  IntervalNs period{IntervalMs{10000}};
+};
+
+/**
+ * @brief Periodically writes metrics registry to file.
+ *
+ * Export runs as repeating task on given dispatcher, which is allowed to do
+ * file I/O. Last export is written on destruction, so file holds final values
+ * after process exits normally.
+ *
+ */
+class MetricsFileExporter {
+ public:
+  MetricsFileExporter(MetricsRegistry& registry,
+                      MetricsFileExporterOptions options,
+                      std::shared_ptr<DispatchTask> dispatcher);
+  ~MetricsFileExporter();
+
+  MetricsFileExporter(const MetricsFileExporter&) = delete;
+  MetricsFileExporter& operator=(const MetricsFileExporter&) = delete;
+
+ private:
+  MetricsRegistry& registry_;
+  const MetricsFileExporterOptions options_;
+  std::shared_ptr<DispatchTask> dispatcher_;
+  TaskHandle export_task_handle_;
+};
+}  // namespace mk
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+
+namespace mk {
+/**
+ * @brief Intrusive lock-free multi-producer single-consumer FIFO queue.
+ *
+ * Push is wait-free and may be called from any thread. Pop may be called
+ * from any thread too, but never concurrently: consumers must be serialized
+ * by a mutex held around every Pop, which also publishes consumer state
+ * between them. Pop may report empty queue while producer is in the middle
+ * of Push. Producer is expected to notify consumer after Push returns.
+ *
+ * Queue doesn't own nodes and never allocates memory.
+ *
+ * @tparam T Node type.
+ * @tparam kNext Node member used as queue link.
+ */
+template <typename T, std::atomic<T*> T::*kNext>
+class MpscQueue {
+ public:
+  MpscQueue() : head_{&stub_}, tail_{&stub_} {}
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  /**
+   * @brief Push node to queue.
+   *
+   * @param node Node to be pushed.
+   */
+  void Push(T* node) {
+    (node->*kNext).store(nullptr, std::memory_order_relaxed);
+    auto* prev = head_.exchange(node, std::memory_order_acq_rel);
+    (prev->*kNext).store(node, std::memory_order_release);
+  }
+
+  /**
+   * @brief Pop node from queue. Callers must be serialized.
+   *
+   * @return Node or nullptr if queue is empty.
+   */
+  T* Pop() {
+    auto* tail = tail_;
+    auto* next = (tail->*kNext).load(std::memory_order_acquire);
+
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+
+      tail_ = next;
+      tail = next;
+      next = (next->*kNext).load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+
+    if (tail != head_.load(std::memory_order_acquire)) {
+      // Producer has not linked next node yet.
+      return nullptr;
+    }
+
+    Push(&stub_);
+
+    next = (tail->*kNext).load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+
+    return nullptr;
+  }
+
+ private:
+  alignas(64) std::atomic<T*> head_;
+  alignas(64) T* tail_;
+  T stub_;
+};
+}  // namespace mk
\ No newline at end of file
@@ -2,12 +2,28 @@
 
 #include <stddef.h>
 
-#include <functional>
+#include <atomic>
+#include <cstdint>
 
+#include "task_priority.h"
 #include "time_types.h"
+#include "timer_options.h"
+#include "unique_task.h"
 
 namespace mk {
-using Task = std::function<void()>;
+using Task = UniqueTask;
+
+#if defined(MK_ENABLE_TRACING)
+/**
+ * @brief Task tracing data.
+ *
+ */
+struct TaskTrace {
+  Location posted_from;
+  std::uint64_t flow_id{0};    ///< Links post and run events. 0 if linked.
+  std::uint64_t post_time{0};  ///< Trace clock nanoseconds.
+};
+#endif
 
 /**
  * @brief Encapsulates pending task data.
@@ -17,19 +33,45 @@ struct PendingTask {
  public:
   PendingTask() : task{[]() {}}, times{0}, period{0}, next_call{0} {};
 
-  PendingTask(Task&& pending_task, size_t count, IntervalMs interval,
-              TimestampMs when)
+  PendingTask(Task&& pending_task, size_t count, IntervalNs interval,
+              TimestampNs when)
       : task{std::move(pending_task)},
         times{count},
         period{interval},
         next_call{when} {}
 
-  PendingTask(Task&& pending_task, TimestampMs when)
-      : PendingTask(std::move(pending_task), 1, IntervalMs{0}, when) {}
+  PendingTask(Task&& pending_task, TimestampNs when)
+      : PendingTask(std::move(pending_task), 1, IntervalNs{0}, when) {}
 
   Task task;
   size_t times;
-  IntervalMs period;
-  TimestampMs next_call;
+  IntervalNs period;
+  TimestampNs next_call;  ///< Planned call delayed by slack. Queues use it.
+
+  RepeatMode repeat_mode{RepeatMode::kFixedDelay};
+  IntervalNs slack{0};
+  TimestampNs planned_call{0};  ///< Call time without slack.
+
+  static constexpr std::size_t kNotQueued = SIZE_MAX;
+
+  std::uint32_t owner{0};       ///< Id of PendingTaskPool.
+  std::uint32_t slot{0};        ///< Slot index in PendingTaskPool.
+  std::uint32_t generation{0};  ///< Slot reuse counter. 0 is never alive.
+  std::atomic<PendingTask*> next_queued{nullptr};  ///< MpscQueue link.
+  std::size_t queue_index{kNotQueued};  ///< Position in TaskQueue.
+  PendingTask* queue_prev{nullptr};     ///< TimingWheelTaskQueue link.
+  PendingTask* queue_next{nullptr};     ///< TimingWheelTaskQueue link.
+  std::atomic<bool> is_cancelled{false};  ///< Cancelled out of the queues.
+
+  TaskPriority priority{TaskPriority::kUserVisible};
+  bool is_in_lane{false};            ///< Task is in TaskLanes.
+  PendingTask* lane_prev{nullptr};   ///< TaskLanes link.
+  PendingTask* lane_next{nullptr};   ///< TaskLanes link.
+  /// ThreadPoolRunLoop worker which holds task in its lanes.
+  std::atomic<std::size_t> worker_index{kNotQueued};
+
+#if defined(MK_ENABLE_TRACING)
+  TaskTrace trace;
+#endif
 };
 }  // namespace mk
\ No newline at end of file
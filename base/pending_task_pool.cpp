@@ -0,0 +1,133 @@
+#include "pending_task_pool.h"
+
+#include <cassert>
+#include <new>
+
+#include "task_schedule.h"
+#include "trace_log.h"
+
+namespace mk {
+namespace {
+constexpr std::uint64_t kTagIncrement = std::uint64_t{1} << 32;
+
+std::uint32_t GetFreeIndex(std::uint64_t head) {
+  return static_cast<std::uint32_t>(head);
+}
+
+std::uint64_t MakeHead(std::uint64_t previous_head, std::uint32_t index) {
+  return ((previous_head & ~std::uint64_t{UINT32_MAX}) + kTagIncrement) |
+         index;
+}
+}  // namespace
+
+PendingTaskPool::PendingTaskPool()
+    : owner_{TaskHandle::MakeOwner()}, chunks_count_{0}, free_head_{0} {}
+
+PendingTaskPool::~PendingTaskPool() {
+  for (auto& chunk : chunks_) {
+    delete chunk.load();
+  }
+}
+
+PendingTask* PendingTaskPool::Acquire(Task&& task, size_t times,
+                                      IntervalNs period, TimestampNs when,
+                                      TaskPriority priority,
+                                      TimerOptions options) {
+  auto head = free_head_.load(std::memory_order_acquire);
+
+  while (true) {
+    const auto free_index = GetFreeIndex(head);
+    if (free_index == 0) {
+      Grow();
+      head = free_head_.load(std::memory_order_acquire);
+      continue;
+    }
+
+    auto& slot = GetSlot(free_index - 1);
+    const auto next_free = slot.next_free.load(std::memory_order_relaxed);
+
+    if (free_head_.compare_exchange_weak(head, MakeHead(head, next_free),
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+      auto& pending_task = slot.task;
+      pending_task.task = std::move(task);
+      pending_task.times = times;
+      pending_task.period = period;
+      pending_task.repeat_mode = options.repeat_mode;
+      pending_task.slack = options.slack;
+      pending_task.planned_call = when;
+      pending_task.next_call = CoalesceCallTime(when, options.slack);
+      pending_task.priority = priority;
+      pending_task.is_cancelled.store(false, std::memory_order_relaxed);
+      TraceTaskPosted(pending_task);
+
+      return &pending_task;
+    }
+  }
+}
+
+void PendingTaskPool::Release(PendingTask* pending_task) {
+  pending_task->task = nullptr;
+  if (++pending_task->generation == 0) {
+    pending_task->generation = 1;
+  }
+
+  PushFree(pending_task->slot + 1, GetSlot(pending_task->slot));
+}
+
+PendingTask* PendingTaskPool::Find(const TaskHandle& handle) const {
+  if (handle.generation == 0 || handle.owner != owner_ ||
+      handle.slot >= chunks_count_ * kChunkSize) {
+    return nullptr;
+  }
+
+  auto& pending_task = GetSlot(handle.slot).task;
+  return pending_task.generation == handle.generation ? &pending_task
+                                                      : nullptr;
+}
+
+PendingTaskPool::Slot& PendingTaskPool::GetSlot(std::uint32_t index) const {
+  return chunks_[index / kChunkSize].load(std::memory_order_acquire)
+      ->slots[index % kChunkSize];
+}
+
+void PendingTaskPool::PushFree(std::uint32_t first, Slot& last) {
+  auto head = free_head_.load(std::memory_order_relaxed);
+
+  do {
+    last.next_free.store(GetFreeIndex(head), std::memory_order_relaxed);
+  } while (!free_head_.compare_exchange_weak(head, MakeHead(head, first),
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+}
+
+void PendingTaskPool::Grow() {
+  std::lock_guard lock{grow_guard_};
+
+  if (GetFreeIndex(free_head_.load(std::memory_order_acquire)) != 0) {
+    // Another thread has grown pool or slot has been released.
+    return;
+  }
+
+  const auto chunk_index = chunks_count_.load();
+  if (chunk_index == kMaxChunksCount) {
+    throw std::bad_alloc{};
+  }
+
+  auto* chunk = new Chunk{};
+  const auto first_index = chunk_index * kChunkSize;
+
+  for (std::uint32_t i = 0; i < kChunkSize; ++i) {
+    auto& slot = chunk->slots[i];
+    slot.task.owner = owner_;
+    slot.task.slot = first_index + i;
+    slot.task.generation = 1;
+    slot.next_free.store(first_index + i + 2, std::memory_order_relaxed);
+  }
+
+  chunks_[chunk_index].store(chunk, std::memory_order_release);
+  chunks_count_ = chunk_index + 1;
+
+  PushFree(first_index + 1, chunk->slots.back());
+}
+}  // namespace mk
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "pending_task.h"
+#include "task_handle.h"
+
+namespace mk {
+/**
+ * @brief Slab of reusable pending tasks.
+ *
+ * Tasks are allocated in chunks which are never freed until pool is
+ * destroyed, so task addresses stay stable. Free slots are kept in lock-free
+ * list, so Acquire() and Release() may be called from any thread and don't
+ * allocate memory in steady state.
+ *
+ * Find() must not race with Release() of the same slot. Dispatcher is
+ * expected to serialize them with own lock. Handles of other pools are
+ * never found.
+ *
+ */
+class PendingTaskPool {
+ public:
+  PendingTaskPool();
+  ~PendingTaskPool();
+
+  PendingTaskPool(const PendingTaskPool&) = delete;
+  PendingTaskPool& operator=(const PendingTaskPool&) = delete;
+
+  /**
+   * @brief Take free slot and fill it with task data.
+   *
+   * @param task Task to be done.
+   * @param times Task execution times.
+   * @param period Delay between tasks execution.
+   * @param when First call timestamp.
+   * @param priority Task priority.
+   * @param options Repeat mode and slack.
+   * @return Pending task.
+   */
+  PendingTask* Acquire(Task&& task, size_t times, IntervalNs period,
+                       TimestampNs when, TaskPriority priority,
+                       TimerOptions options = {});
+
+  /**
+   * @brief Return slot to pool. Outstanding handles of task become stale.
+   *
+   * @param pending_task Pending task from Acquire().
+   */
+  void Release(PendingTask* pending_task);
+
+  /**
+   * @brief Find alive task by handle.
+   *
+   * @param handle Task handle.
+   * @return Pending task or nullptr if task has been released.
+   */
+  PendingTask* Find(const TaskHandle& handle) const;
+
+ private:
+  static constexpr std::uint32_t kChunkSize = 256;
+  static constexpr std::uint32_t kMaxChunksCount = 1024;
+
+  struct Slot {
+    PendingTask task;
+    std::atomic<std::uint32_t> next_free{0};  ///< Next free slot index + 1.
+  };
+
+  struct Chunk {
+    std::array<Slot, kChunkSize> slots;
+  };
+
+  Slot& GetSlot(std::uint32_t index) const;
+  void PushFree(std::uint32_t first, Slot& last);
+  void Grow();
+
+  const std::uint32_t owner_;
+  std::array<std::atomic<Chunk*>, kMaxChunksCount> chunks_{};
+  std::atomic<std::uint32_t> chunks_count_;
+
+  /// Tagged head of free list: ABA tag in high half, slot index + 1 in low.
+  std::atomic<std::uint64_t> free_head_;
+  std::mutex grow_guard_;
+};
+}  // namespace mk
\ No newline at end of file
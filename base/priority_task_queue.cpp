@@ -3,27 +3,24 @@
 #include <cassert>
 
 namespace mk {
-TaskHandle PriorityTaskQueue::AddTask(std::shared_ptr<PendingTask> task) {
-  TaskHandle handle{task};
-  queue_.push(std::move(task));
+void PriorityTaskQueue::AddTask(PendingTask* task) { heap_.Push(task); }
 
-  return handle;
-}
-
-std::shared_ptr<PendingTask> PriorityTaskQueue::PopTask() {
+PendingTask* PriorityTaskQueue::PopTask() {
   assert(!IsEmpty() && "PopTask(). PriorityTaskQueue is empty.");
 
-  auto pending_task = queue_.top();
-  queue_.pop();
+  auto* pending_task = heap_.GetTop();
+  heap_.Remove(pending_task);
 
   return pending_task;
 }
 
-bool PriorityTaskQueue::IsEmpty() const { return queue_.empty(); }
+void PriorityTaskQueue::RemoveTask(PendingTask* task) { heap_.Remove(task); }
+
+bool PriorityTaskQueue::IsEmpty() const { return heap_.IsEmpty(); }
 
-TimestampMs PriorityTaskQueue::GetNextTaskCallTime() const {
+TimestampNs PriorityTaskQueue::GetNextTaskCallTime() const {
   assert(!IsEmpty() && "GetNextTaskCallTime(). PriorityTaskQueue is empty.");
 
-  return queue_.top()->next_call;
+  return heap_.GetTop()->next_call;
 }
 }  // namespace mk
\ No newline at end of file
@@ -1,44 +1,34 @@
 #pragma once
 
-#include <functional>
-#include <queue>
-
+#include "task_heap.h"
 #include "task_queue.h"
 
 namespace mk {
 /**
  * @brief Task call time priority queue.
  *
+ * Binary heap which keeps heap position in every task, so any task can be
+ * removed in O(log n).
+ *
  */
 class PriorityTaskQueue : public TaskQueue {
  public:
   /** @see TaskQueue. */
-  TaskHandle AddTask(std::shared_ptr<PendingTask> task) override;
+  void AddTask(PendingTask* task) override;
 
   /** @see TaskQueue. */
-  std::shared_ptr<PendingTask> PopTask() override;
+  PendingTask* PopTask() override;
+
+  /** @see TaskQueue. */
+  void RemoveTask(PendingTask* task) override;
 
   /** @see TaskQueue. */
   bool IsEmpty() const override;
 
   /** @see TaskQueue. */
-  TimestampMs GetNextTaskCallTime() const override;
+  TimestampNs GetNextTaskCallTime() const override;
 
  private:
-  /**
-   * @brief Pending task priority comparator.
-   *
-   */
-  struct PendignTaskPriorityComparator {
-    bool operator()(std::shared_ptr<PendingTask> lhs,
-                    std::shared_ptr<PendingTask> rhs) const {
-      return lhs->next_call > rhs->next_call;
-    }
-  };
-
-  std::priority_queue<std::shared_ptr<PendingTask>,
-                      std::vector<std::shared_ptr<PendingTask>>,
-                      PendignTaskPriorityComparator>
-      queue_;
+  TaskHeap heap_;
 };
 }  // namespace mk
\ No newline at end of file
@@ -1,110 +1,407 @@
 #include "run_loop.h"
 
 #include <limits>
+#include <utility>
 
 #include "task_pump.h"
 #include "task_queue.h"
+#include "task_schedule.h"
+#include "task_watchdog.h"
 #include "time_provider.h"
+#include "trace_log.h"
 
 namespace mk {
+namespace {
+thread_local const RunLoop* current_loop = nullptr;
+}  // namespace
+
 RunLoop::RunLoop(std::unique_ptr<TaskPump> task_pump,
                  std::unique_ptr<TaskQueue> task_queue,
                  std::shared_ptr<TimeProvider> time_provider)
+    : RunLoop(RunLoopOptions{}, std::move(task_pump), std::move(task_queue),
+              std::move(time_provider)) {}
+
+RunLoop::RunLoop(RunLoopOptions options, std::unique_ptr<TaskPump> task_pump,
+                 std::unique_ptr<TaskQueue> task_queue,
+                 std::shared_ptr<TimeProvider> time_provider)
     : pump_{std::move(task_pump)},
       queue_{std::move(task_queue)},
       time_provider_{std::move(time_provider)},
-      is_running_{false} {}
+      is_running_{false},
+      capacity_{options.capacity, options.overflow_policy} {
+  ready_tasks_.reserve(kMaxBatchSize);
+  finished_tasks_.reserve(kMaxBatchSize);
+}
 
 void RunLoop::Run() {
+  const auto* const previous_loop = std::exchange(current_loop, this);
   is_running_ = true;
 
   while (is_running_) {
-    std::unique_lock lock{task_quard_};
+    auto call_time = TimestampNs::max();
 
-    if (queue_->IsEmpty()) {
-      lock.unlock();
-      pump_->WaitUntil(TimestampMs::max());
-      continue;
+    if (PopReadyTasks(call_time)) {
+      RunReadyTasks();
+    } else {
+      pump_->WaitUntil(call_time);
     }
+  }
 
-    const auto now = time_provider_->Now();
-    const auto call_time = queue_->GetNextTaskCallTime();
-    const bool is_ready_to_perform = call_time <= now;
-
-    if (is_ready_to_perform) {
-      auto pending_task = queue_->PopTask();
-      auto task = pending_task->task;
+  current_loop = previous_loop;
+}
 
-      lock.unlock();
-      task();
-      lock.lock();
+void RunLoop::Stop() {
+  is_running_ = false;
+  pump_->Notify();
 
-      if (!is_running_) {
-        break;
-      }
+  // Blocked posters give up waiting for stopped loop.
+  capacity_.WakeUpBlocked();
+}
 
-      if (pending_task->times > 1) {
-        --pending_task->times;
-        pending_task->next_call = now + pending_task->period;
+void RunLoop::SetWatchdog(TaskWatchdog& watchdog, const std::string& name) {
+  heartbeat_ = watchdog.AddLoopThread(name);
+}
 
-        task_quard_.unlock();
-        PostTask(std::move(pending_task));
-      }
+void RunLoop::SetMetrics(MetricsRegistry& registry, const std::string& name) {
+  metrics_ = TaskLoopMetrics{registry, name};
+}
 
-    } else {
-      task_quard_.unlock();
-      pump_->WaitUntil(call_time);
-    }
+TaskHandle RunLoop::PostTask(Task task, TaskPriority priority) {
+  if (!AcquireCapacity()) {
+    return {};
   }
-}
 
-void RunLoop::Stop() {
-  is_running_ = false;
+  auto* pending_task = pool_.Acquire(std::move(task), 1, IntervalNs{0},
+                                     time_provider_->Now(), priority);
+  TaskHandle handle{*pending_task};
+  immediate_queue_.Push(pending_task);
   pump_->Notify();
+
+  return handle;
 }
 
-TaskHandle RunLoop::PostTask(Task task) {
-  return PostDelayedTask(std::move(task), IntervalMs{0});
+std::vector<TaskHandle> RunLoop::PostTasks(std::vector<Task> tasks,
+                                           TaskPriority priority) {
+  const auto now = time_provider_->Now();
+
+  std::vector<TaskHandle> handles;
+  handles.reserve(tasks.size());
+
+  bool has_pushed_tasks = false;
+  for (auto& task : tasks) {
+    if (!AcquireCapacity()) {
+      handles.emplace_back();
+      continue;
+    }
+
+    auto* pending_task =
+        pool_.Acquire(std::move(task), 1, IntervalNs{0}, now, priority);
+    handles.emplace_back(*pending_task);
+    immediate_queue_.Push(pending_task);
+    has_pushed_tasks = true;
+  }
+
+  if (has_pushed_tasks) {
+    pump_->Notify();
+  }
+
+  return handles;
 }
 
 TaskHandle RunLoop::PostRepeatingTask(Task task, size_t times,
-                                      IntervalMs period) {
-  return PostTask(std::move(task), times, period, time_provider_->Now());
+                                      IntervalNs period,
+                                      TaskPriority priority,
+                                      TimerOptions options) {
+  return PostTask(std::move(task), times, period, time_provider_->Now(),
+                  priority, options);
 }
 
-TaskHandle RunLoop::PostDelayedTask(Task task, IntervalMs delay) {
-  return PostTask(std::move(task), 1, IntervalMs{0},
-                  time_provider_->Now() + delay);
+TaskHandle RunLoop::PostDelayedTask(Task task, IntervalNs delay,
+                                    TaskPriority priority,
+                                    TimerOptions options) {
+  return PostTask(std::move(task), 1, IntervalNs{0},
+                  time_provider_->Now() + delay, priority, options);
 }
 
 void RunLoop::CancelTask(TaskHandle&& handle) {
-  auto task_ptr = handle.task.lock();
-  if (std::lock_guard lock{task_quard_}; task_ptr) {
-    task_ptr->task = []() {};
-    task_ptr->times = 0;
+  // Task state is destroyed out of lock, it may post or cancel tasks.
+  Task cancelled_task;
+  {
+    std::lock_guard lock{task_quard_};
+    auto* task_ptr = pool_.Find(handle);
+    if (!task_ptr) {
+      return;
+    }
+
+    if (task_ptr->is_in_lane) {
+      lanes_.Remove(task_ptr);
+      cancelled_task = std::move(task_ptr->task);
+      pool_.Release(task_ptr);
+      capacity_.Release(1);
+      return;
+    }
+
+    if (task_ptr->queue_index == PendingTask::kNotQueued) {
+      // Task is taken for running or waits in immediate queue. Loop owns it
+      // and skips or releases it.
+      task_ptr->is_cancelled.store(true, std::memory_order_release);
+      return;
+    }
+
+    const auto call_time = queue_->GetNextTaskCallTime();
+    queue_->RemoveTask(task_ptr);
+    cancelled_task = std::move(task_ptr->task);
+    pool_.Release(task_ptr);
+
+    if (!queue_->IsEmpty() && queue_->GetNextTaskCallTime() == call_time) {
+      return;
+    }
+  }
+
+  // Let loop recalculate wake up time without removed task.
+  pump_->Notify();
+}
+
+void RunLoop::UpdateTaskPriority(const TaskHandle& handle,
+                                 TaskPriority priority) {
+  std::lock_guard lock{task_quard_};
+  auto* task_ptr = pool_.Find(handle);
+  if (!task_ptr || task_ptr->priority == priority) {
+    return;
+  }
+
+  if (task_ptr->is_in_lane) {
+    lanes_.Remove(task_ptr);
+    task_ptr->priority = priority;
+    lanes_.Push(task_ptr);
+  } else {
+    // Priority is applied when task becomes ready.
+    task_ptr->priority = priority;
   }
 }
 
-TaskHandle RunLoop::PostTask(Task task, size_t times, IntervalMs period,
-                             TimestampMs when) {
+TaskHandle RunLoop::PostCoalescedTask(const std::string& key, Task task,
+                                      TaskPriority priority) {
+  // Task state is destroyed out of lock, it may post or cancel tasks.
+  Task replaced_task;
+  {
+    std::lock_guard coalesced_lock{coalesced_guard_};
+    std::lock_guard lock{task_quard_};
+    if (auto* task_ptr =
+            ReplaceCoalescedTaskLocked(key, task, priority, replaced_task)) {
+      return TaskHandle{*task_ptr};
+    }
+  }
+
+  // Poster may wait for capacity, so it is taken out of guards.
+  if (!AcquireCapacity()) {
+    return {};
+  }
+
   TaskHandle handle;
+  auto is_replaced = false;
+  {
+    std::lock_guard coalesced_lock{coalesced_guard_};
+    std::lock_guard lock{task_quard_};
+    if (auto* task_ptr =
+            ReplaceCoalescedTaskLocked(key, task, priority, replaced_task)) {
+      // Task with the key has been posted meanwhile.
+      handle = TaskHandle{*task_ptr};
+      is_replaced = true;
+    } else {
+      auto* pending_task = pool_.Acquire(std::move(task), 1, IntervalNs{0},
+                                         time_provider_->Now(), priority);
+      handle = TaskHandle{*pending_task};
+      lanes_.Push(pending_task);
+      coalesced_tasks_[key] = handle;
+    }
+  }
+
+  if (is_replaced) {
+    // Replaced task holds capacity already.
+    capacity_.Release(1);
+  } else {
+    pump_->Notify();
+  }
+
+  return handle;
+}
+
+TaskHandle RunLoop::PostTask(Task task, size_t times, IntervalNs period,
+                             TimestampNs when, TaskPriority priority,
+                             TimerOptions options) {
+  auto* pending_task = pool_.Acquire(std::move(task), times, period, when,
+                                     priority, options);
+  TaskHandle handle{*pending_task};
   {
     std::unique_lock lock{task_quard_};
-    handle = queue_->AddTask(
-        std::make_shared<PendingTask>(std::move(task), times, period, when));
+    queue_->AddTask(pending_task);
   }
   pump_->Notify();
 
   return handle;
 }
 
-void RunLoop::PostTask(std::shared_ptr<PendingTask>&& task) {
+bool RunLoop::PopReadyTasks(TimestampNs& call_time) {
+  std::size_t started_count = 0;
   {
-    std::unique_lock lock{task_quard_};
-    queue_->AddTask(std::move(task));
+    std::lock_guard lock{task_quard_};
+
+    while (auto* pending_task = immediate_queue_.Pop()) {
+      if (pending_task->is_cancelled.load(std::memory_order_relaxed)) {
+        // Release it together with the batch.
+        ready_tasks_.push_back(pending_task);
+        ++started_count;
+      } else {
+        lanes_.Push(pending_task);
+      }
+    }
+
+    const auto now = time_provider_->Now();
+    std::size_t due_count = 0;
+    while (!queue_->IsEmpty()) {
+      if (const auto next_call = queue_->GetNextTaskCallTime();
+          next_call > now) {
+        call_time = next_call;
+        break;
+      }
+
+      lanes_.Push(queue_->PopTask());
+      ++due_count;
+    }
+    capacity_.Add(due_count);
+
+    for (std::size_t i = 0; i < kMaxBatchSize; ++i) {
+      auto* pending_task = lanes_.Pop();
+      if (!pending_task) {
+        break;
+      }
+
+      ready_tasks_.push_back(pending_task);
+      ++started_count;
+    }
   }
 
-  pump_->Notify();
+  capacity_.Release(started_count);
+
+  return !ready_tasks_.empty();
+}
+
+void RunLoop::RunReadyTasks() {
+  // Tasks taken from lanes are owned by loop. CancelTask only marks them.
+  std::size_t run_count = 0;
+  for (auto* pending_task : ready_tasks_) {
+    const auto is_cancelled =
+        pending_task->is_cancelled.load(std::memory_order_acquire);
+
+    if (is_running_ && !is_cancelled) {
+      ScopedTaskTrace trace{*pending_task};
+      ScopedTaskHeartbeat heartbeat{heartbeat_.get(),
+                                    pending_task->task.GetLocation()};
+      pending_task->task();
+      ++run_count;
+    }
+
+    // Task may cancel itself or be cancelled by other thread while it runs.
+    if (!is_running_ || pending_task->times <= 1 ||
+        pending_task->is_cancelled.load(std::memory_order_acquire)) {
+      // Destroy task state out of lock, it may post or cancel tasks.
+      pending_task->task = nullptr;
+    } else {
+      ScheduleNextCall(*pending_task, time_provider_->Now());
+    }
+  }
+
+  std::size_t ready_count = 0;
+  {
+    std::lock_guard lock{task_quard_};
+    for (auto* pending_task : ready_tasks_) {
+      if (pending_task->task && is_running_ &&
+          !pending_task->is_cancelled.load(std::memory_order_relaxed)) {
+        --pending_task->times;
+        queue_->AddTask(pending_task);
+        continue;
+      }
+
+      if (pending_task->task) {
+        // Cancelled after the check above, its state is destroyed below.
+        finished_tasks_.push_back(std::move(pending_task->task));
+      }
+      pool_.Release(pending_task);
+    }
+
+    ready_tasks_.clear();
+    ready_count = lanes_.GetSize();
+  }
+
+  finished_tasks_.clear();
+  metrics_.TasksRun(run_count, ready_count);
+}
+
+bool RunLoop::AcquireCapacity() {
+  return capacity_.TryAcquire() ||
+         capacity_.Acquire(
+             current_loop == this, is_running_,
+             [this]() { return DropOldestTask(); },
+             [this]() {
+               // Tasks posted before by this thread may wait for
+               // notification.
+               pump_->Notify();
+             });
+}
+
+void RunLoop::MoveImmediateTasksLocked() {
+  // Cancelled tasks are skipped when they are taken from lanes, they take
+  // no new work meanwhile.
+  while (auto* pending_task = immediate_queue_.Pop()) {
+    lanes_.Push(pending_task);
+  }
+}
+
+bool RunLoop::DropOldestTask() {
+  Task dropped_task;
+
+  std::lock_guard lock{task_quard_};
+  MoveImmediateTasksLocked();
+
+  auto* task_ptr = lanes_.FindOldestOneShotTask();
+  if (!task_ptr) {
+    return false;
+  }
+
+  lanes_.Remove(task_ptr);
+  // Destroy task state out of lock, it may post or cancel tasks.
+  dropped_task = std::move(task_ptr->task);
+  pool_.Release(task_ptr);
+
+  return true;
 }
 
-}  // namespace mk
\ No newline at end of file
+PendingTask* RunLoop::ReplaceCoalescedTaskLocked(const std::string& key,
+                                                 Task& task,
+                                                 TaskPriority priority,
+                                                 Task& replaced_task) {
+  MoveImmediateTasksLocked();
+
+  const auto it = coalesced_tasks_.find(key);
+  if (it == coalesced_tasks_.end()) {
+    return nullptr;
+  }
+
+  auto* task_ptr = pool_.Find(it->second);
+  if (!task_ptr || !task_ptr->is_in_lane ||
+      task_ptr->is_cancelled.load(std::memory_order_relaxed)) {
+    return nullptr;
+  }
+
+  // Pending task keeps its place in lane and takes new work.
+  replaced_task = std::exchange(task_ptr->task, std::move(task));
+  if (task_ptr->priority != priority) {
+    lanes_.Remove(task_ptr);
+    task_ptr->priority = priority;
+    lanes_.Push(task_ptr);
+  }
+
+  return task_ptr;
+}
+}  // namespace mk
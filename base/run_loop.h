@@ -3,19 +3,47 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "dispatch_task.h"
+#include "mpsc_queue.h"
 #include "pending_task.h"
+#include "pending_task_pool.h"
+#include "task_capacity.h"
+#include "task_lanes.h"
 #include "task_loop.h"
+#include "task_loop_metrics.h"
 
 namespace mk {
+class TaskHeartbeat;
 class TaskPump;
 class TaskQueue;
 class TimeProvider;
 
+/**
+ * @brief RunLoop configuration.
+ *
+ */
+struct RunLoopOptions {
+  /// Most ready tasks waiting to start. Zero means unbounded.
+  std::size_t capacity{0};
+
+  OverflowPolicy overflow_policy{OverflowPolicy::kBlock};
+};
+
 /**
  * @brief Processes tasks for thread.
  *
+ * Immediate tasks are posted to lock-free queue. Only delayed and repeating
+ * tasks are ordered by call time in task queue. Ready tasks are taken from
+ * priority lanes in batches, so lock is taken twice per batch rather than
+ * per task.
+ *
+ * Ready tasks of bounded loop are counted by TaskCapacity. Repeating tasks
+ * are never dropped.
+ *
  */
 class RunLoop : public TaskLoop, public DispatchTask {
  public:
@@ -23,36 +51,136 @@ class RunLoop : public TaskLoop, public DispatchTask {
           std::unique_ptr<TaskQueue> task_queue,
           std::shared_ptr<TimeProvider> time_provider);
 
+  RunLoop(RunLoopOptions options, std::unique_ptr<TaskPump> task_pump,
+          std::unique_ptr<TaskQueue> task_queue,
+          std::shared_ptr<TimeProvider> time_provider);
+
   /** @see TaskLoop.*/
   void Run() override;
 
   /** @see TaskLoop. */
   void Stop() override;
 
+  /** @see TaskLoop. */
+  void SetWatchdog(TaskWatchdog& watchdog, const std::string& name) override;
+
+  /** @see TaskLoop. */
+  void SetMetrics(MetricsRegistry& registry, const std::string& name) override;
+
+  using DispatchTask::PostDelayedTask;
+  using DispatchTask::PostRepeatingTask;
+  using DispatchTask::PostTask;
+  using DispatchTask::PostTasks;
+
+  /** @see DispatchTask. */
+  TaskHandle PostTask(Task task, TaskPriority priority) override;
+
   /** @see DispatchTask. */
-  TaskHandle PostTask(Task task) override;
+  std::vector<TaskHandle> PostTasks(std::vector<Task> tasks,
+                                    TaskPriority priority) override;
 
   /** @see DispatchTask. */
-  TaskHandle PostRepeatingTask(Task task, size_t times,
-                               IntervalMs period) override;
+  TaskHandle PostRepeatingTask(Task task, size_t times, IntervalNs period,
+                               TaskPriority priority,
+                               TimerOptions options) override;
 
   /** @see DispatchTask. */
-  TaskHandle PostDelayedTask(Task task, IntervalMs delay) override;
+  TaskHandle PostDelayedTask(Task task, IntervalNs delay,
+                             TaskPriority priority,
+                             TimerOptions options) override;
 
   /** @see DispatchTask. */
   void CancelTask(TaskHandle&& handle) override;
 
+  /** @see DispatchTask. */
+  void UpdateTaskPriority(const TaskHandle& handle,
+                          TaskPriority priority) override;
+
+  /**
+   * @brief Post immediate task replacing pending task with the same key.
+   *
+   * Replaced task never runs. Task which has started already isn't
+   * replaced. Every distinct key keeps small map entry while loop lives.
+   *
+   * @param key Coalescing key.
+   * @param task Task to be done.
+   * @param priority Task priority.
+   * @return Task handle. Empty if bounded loop rejects task.
+   */
+  TaskHandle PostCoalescedTask(const std::string& key, Task task,
+                               TaskPriority priority);
+
+  /** @brief Post user visible coalesced task. */
+  TaskHandle PostCoalescedTask(const std::string& key, Task task) {
+    return PostCoalescedTask(key, std::move(task), TaskPriority::kUserVisible);
+  }
+
  private:
-  TaskHandle PostTask(Task task, size_t times, IntervalMs period,
-                      TimestampMs when);
+  TaskHandle PostTask(Task task, size_t times, IntervalNs period,
+                      TimestampNs when, TaskPriority priority,
+                      TimerOptions options);
 
-  void PostTask(std::shared_ptr<PendingTask>&& task);
+  /// Batch is bounded to let new high priority tasks overtake the rest.
+  static constexpr std::size_t kMaxBatchSize = 64;
 
+  bool PopReadyTasks(TimestampNs& call_time);
+  void RunReadyTasks();
+
+  /**
+   * @brief Take capacity for immediate task, applying overflow policy.
+   *
+   * @return false if task is rejected.
+   */
+  bool AcquireCapacity();
+
+  /**
+   * @brief Move posted tasks to lanes, so they can be dropped or replaced.
+   * Posters pop immediate queue here, task guard serializes them with loop.
+   *
+   */
+  void MoveImmediateTasksLocked();
+
+  /**
+   * @brief Drop oldest ready task of lowest priority.
+   *
+   * @return true if new task may take capacity of dropped one.
+   */
+  bool DropOldestTask();
+
+  /**
+   * @brief Give new work to pending task with the key.
+   *
+   * @param key Coalescing key.
+   * @param task New work, moved from only if task is replaced.
+   * @param priority New priority.
+   * @param replaced_task Receives replaced work, so it is destroyed out of
+   * lock.
+   * @return Task which takes new work or nullptr.
+   */
+  PendingTask* ReplaceCoalescedTaskLocked(const std::string& key, Task& task,
+                                          TaskPriority priority,
+                                          Task& replaced_task);
+
+  PendingTaskPool pool_;
   std::unique_ptr<TaskPump> pump_;
   std::unique_ptr<TaskQueue> queue_;
+  /// Popped under task guard only, by loop or by bounded and coalescing
+  /// posters.
+  MpscQueue<PendingTask, &PendingTask::next_queued> immediate_queue_;
+  TaskLanes lanes_;
+  std::vector<PendingTask*> ready_tasks_;
+  std::vector<Task> finished_tasks_;  ///< Destroyed out of task guard.
   std::shared_ptr<TimeProvider> time_provider_;
+  std::shared_ptr<TaskHeartbeat> heartbeat_;
+  TaskLoopMetrics metrics_;
 
   std::mutex task_quard_;
   std::atomic<bool> is_running_;
+
+  /// Tasks in immediate queue and lanes.
+  TaskCapacity capacity_;
+
+  std::mutex coalesced_guard_;
+  std::unordered_map<std::string, TaskHandle> coalesced_tasks_;
 };
 }  // namespace mk
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <functional>
 
+#include "time_types.h"
+
 namespace mk {
 /**
  * @brief Execute backend specific task (Example: Draw UI in UI run loop, etc).
@@ -11,11 +13,19 @@ class RunLoopBackendExecutor {
  public:
   enum class IterationStatus {
     Ok,    ///< Normal iteration finish.
+    Idle,  ///< Nothing changes, loop may wait for next backend event.
     Done,  ///< Backend execution has stopped.
   };
 
   using BackendTask = std::function<IterationStatus()>;
 
+  /// Block until backend event or timeout. IntervalNs::max() is no timeout.
+  using BackendWait = std::function<void(IntervalNs timeout)>;
+
+  /// Interrupt BackendWait. Called from any thread, must not be lost if
+  /// wait hasn't started yet.
+  using BackendWakeUp = std::function<void()>;
+
   virtual ~RunLoopBackendExecutor() = default;
 
   /**
@@ -24,5 +34,16 @@ class RunLoopBackendExecutor {
    * @param backend_task Backend task.
    */
   virtual void SetBackendTask(BackendTask&& backend_task) = 0;
+
+  /**
+   * @brief Set the way to wait for backend events while backend is idle.
+   *
+   * Without waiter idle iterations run as normal ones.
+   *
+   * @param wait Backend wait.
+   * @param wake_up Backend wait interruption.
+   */
+  virtual void SetBackendWaiter(BackendWait&& wait,
+                                BackendWakeUp&& wake_up) = 0;
 };
 }  // namespace mk
\ No newline at end of file
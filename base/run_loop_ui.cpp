@@ -1,106 +1,467 @@
 #include "run_loop_ui.h"
 
 #include <limits>
+#include <utility>
 
 #include "task_queue.h"
+#include "task_schedule.h"
+#include "task_watchdog.h"
 #include "time_provider.h"
+#include "trace_log.h"
 
 namespace mk {
-RunLoopUi::RunLoopUi(std::unique_ptr<TaskQueue> task_queue,
+namespace {
+thread_local const RunLoopUi* current_loop = nullptr;
+}  // namespace
+
+RunLoopUi::RunLoopUi(RunLoopUiOptions options,
+                     std::unique_ptr<TaskQueue> task_queue,
                      std::unique_ptr<TimeProvider> time_provider)
     : queue_{std::move(task_queue)},
       time_provider_{std::move(time_provider)},
+      options_{options},
       is_running_{false},
-      backend_task_{nullptr} {}
+      capacity_{options.capacity, options.overflow_policy},
+      backend_task_{nullptr},
+      is_waiting_{false} {}
 
 void RunLoopUi::Run() {
+  const auto* const previous_loop = std::exchange(current_loop, this);
   is_running_ = true;
 
   while (is_running_) {
-    std::unique_lock lock{task_quard_};
+    FrameStats stats;
+
+    const auto frame_start = time_provider_->Now();
+    {
+      ScopedTraceEvent trace{"RunLoopUi::Tasks"};
+      std::unique_lock lock{task_quard_};
+      RunTasks(lock, frame_start, stats);
+    }
+
+    const auto backend_start = time_provider_->Now();
+    stats.tasks_time = backend_start - frame_start;
+
+    auto status = RunLoopBackendExecutor::IterationStatus::Ok;
+    if (backend_task_) {
+      ScopedTraceEvent trace{"RunLoopUi::BackendTask"};
+      // Backend task is reported at this location.
+      ScopedTaskHeartbeat heartbeat{heartbeat_.get(), Location::Current()};
+      status = backend_task_();
+    }
 
-    if (!queue_->IsEmpty()) {
-      const auto now = time_provider_->Now();
-      bool is_ready_to_perform = queue_->GetNextTaskCallTime() <= now;
+    if (status == RunLoopBackendExecutor::IterationStatus::Done) {
+      is_running_ = false;
+    }
+
+    stats.backend_time = time_provider_->Now() - backend_start;
+    metrics_.FrameRun(stats);
 
-      while (is_ready_to_perform) {
-        auto pending_task = queue_->PopTask();
-        auto task = pending_task->task;
+    if (status == RunLoopBackendExecutor::IterationStatus::Idle &&
+        backend_wait_) {
+      WaitForWork();
+    }
+  }
 
-        lock.unlock();
-        task();
-        lock.lock();
+  current_loop = previous_loop;
+}
 
-        if (!is_running_) {
-          break;
-        }
+void RunLoopUi::RunTasks(std::unique_lock<std::mutex>& lock, TimestampNs now,
+                         FrameStats& stats) {
+  std::size_t due_count = 0;
+  while (!queue_->IsEmpty() && queue_->GetNextTaskCallTime() <= now) {
+    lanes_.Push(queue_->PopTask());
+    ++due_count;
+  }
+  capacity_.Add(due_count);
 
-        if (pending_task->times > 1) {
-          --pending_task->times;
-          pending_task->next_call = now + pending_task->period;
+  // Tasks posted while frame runs wait for next frame.
+  auto ready_count = lanes_.GetSize();
 
-          task_quard_.unlock();
-          PostTask(std::move(pending_task));
-          task_quard_.lock();
-        }
+  // At least one ready task runs every frame, so loop makes progress with
+  // any budget.
+  const auto budget_end = now + options_.frame_task_budget;
+  auto is_budget_left = true;
 
-        is_ready_to_perform =
-            queue_->IsEmpty() ? false : queue_->GetNextTaskCallTime() <= now;
-      }
+  while (is_budget_left) {
+    PendingTask* pending_task = nullptr;
+    if (ready_count != 0) {
+      pending_task = lanes_.Pop();
+      --ready_count;
+      capacity_.Release(pending_task ? 1 : 0);
     }
 
+    if (!pending_task && time_provider_->Now() < budget_end) {
+      // No ready task waits, spare time goes to idle tasks.
+      pending_task = PopIdleTask();
+    }
+
+    if (!pending_task) {
+      break;
+    }
+
+    ++stats.tasks_count;
+    if (!RunTask(lock, pending_task)) {
+      return;
+    }
+
+    is_budget_left = time_provider_->Now() < budget_end;
+  }
+
+  stats.deferred_tasks_count = lanes_.GetSize();
+}
+
+PendingTask* RunLoopUi::PopIdleTask() {
+  while (!idle_tasks_.empty()) {
+    auto* pending_task = pool_.Find(idle_tasks_.front());
+    idle_tasks_.pop_front();
+
+    // Task has been cancelled or has run by deadline otherwise.
+    if (pending_task && pending_task->queue_index != PendingTask::kNotQueued) {
+      queue_->RemoveTask(pending_task);
+      return pending_task;
+    }
+  }
+
+  return nullptr;
+}
+
+bool RunLoopUi::RunTask(std::unique_lock<std::mutex>& lock,
+                        PendingTask* pending_task) {
+  auto task = std::move(pending_task->task);
+  // Cancellation only lowers times, so the last call stays the last one.
+  const auto is_last_call = pending_task->times <= 1;
+
+  lock.unlock();
+  {
+    ScopedTaskTrace trace{*pending_task};
+    ScopedTaskHeartbeat heartbeat{heartbeat_.get(), task.GetLocation()};
+    task();
+  }
+  if (is_last_call) {
+    // Destroy task state out of lock, it may post or cancel tasks.
+    task = nullptr;
+  }
+  lock.lock();
+  metrics_.TasksRun(1, lanes_.GetSize());
+
+  if (is_running_ && pending_task->times > 1) {
+    --pending_task->times;
+    pending_task->task = std::move(task);
+    ScheduleNextCall(*pending_task, time_provider_->Now());
+    queue_->AddTask(pending_task);
+    return true;
+  }
+
+  pool_.Release(pending_task);
+  if (task) {
+    // Repeating task has been stopped or cancelled while it was running.
     lock.unlock();
-    if (backend_task_) {
-      is_running_ =
-          backend_task_() == RunLoopBackendExecutor::IterationStatus::Ok;
+    task = nullptr;
+    lock.lock();
+  }
+
+  return is_running_;
+}
+
+void RunLoopUi::SetWatchdog(TaskWatchdog& watchdog,
+                            const std::string& name) {
+  heartbeat_ = watchdog.AddLoopThread(name);
+}
+
+void RunLoopUi::SetMetrics(MetricsRegistry& registry,
+                           const std::string& name) {
+  metrics_ = TaskLoopMetrics{registry, name};
+  metrics_.AddFrameSeries(registry, name);
+}
+
+void RunLoopUi::Stop() {
+  std::lock_guard lock{task_quard_};
+  is_running_ = false;
+  WakeUpLocked();
+
+  // Blocked posters give up waiting for stopped loop.
+  capacity_.WakeUpBlocked();
+}
+
+void RunLoopUi::WaitForWork() {
+  std::unique_lock lock{task_quard_};
+  if (!is_running_ || !lanes_.IsEmpty()) {
+    return;
+  }
+
+  auto timeout = IntervalNs::max();
+  if (!queue_->IsEmpty()) {
+    const auto now = time_provider_->Now();
+    const auto call_time = queue_->GetNextTaskCallTime();
+    if (call_time <= now) {
+      return;
     }
+
+    timeout = call_time - now;
   }
+
+  // Posting thread sees the flag under the same guard it adds task with.
+  is_waiting_ = true;
+  lock.unlock();
+
+  {
+    ScopedTraceEvent trace{"RunLoopUi::Wait"};
+    backend_wait_(timeout);
+  }
+  is_waiting_ = false;
 }
 
-void RunLoopUi::Stop() { is_running_ = false; }
+void RunLoopUi::WakeUpLocked() {
+  if (is_waiting_.exchange(false) && backend_wake_up_) {
+    backend_wake_up_();
+  }
+}
+
+TaskHandle RunLoopUi::PostTask(Task task, TaskPriority priority) {
+  if (!AcquireCapacity()) {
+    return {};
+  }
 
-TaskHandle RunLoopUi::PostTask(Task task) {
-  return PostDelayedTask(std::move(task), IntervalMs{0});
+  auto* pending_task = pool_.Acquire(std::move(task), 1, IntervalNs{0},
+                                     time_provider_->Now(), priority);
+  TaskHandle handle{*pending_task};
+  {
+    std::lock_guard lock{task_quard_};
+    lanes_.Push(pending_task);
+    WakeUpLocked();
+  }
+
+  return handle;
+}
+
+std::vector<TaskHandle> RunLoopUi::PostTasks(std::vector<Task> tasks,
+                                             TaskPriority priority) {
+  const auto now = time_provider_->Now();
+
+  std::vector<TaskHandle> handles;
+  handles.reserve(tasks.size());
+
+  std::unique_lock lock{task_quard_};
+  for (auto& task : tasks) {
+    if (!capacity_.TryAcquire()) {
+      // Loop takes tasks posted so far while poster waits for capacity.
+      WakeUpLocked();
+      lock.unlock();
+      const auto is_acquired = AcquireCapacity();
+      lock.lock();
+
+      if (!is_acquired) {
+        handles.emplace_back();
+        continue;
+      }
+    }
+
+    auto* pending_task =
+        pool_.Acquire(std::move(task), 1, IntervalNs{0}, now, priority);
+    handles.emplace_back(*pending_task);
+    lanes_.Push(pending_task);
+  }
+  WakeUpLocked();
+
+  return handles;
 }
 
 TaskHandle RunLoopUi::PostRepeatingTask(Task task, size_t times,
-                                        IntervalMs period) {
-  return PostTask(std::move(task), times, period, time_provider_->Now());
+                                        IntervalNs period,
+                                        TaskPriority priority,
+                                        TimerOptions options) {
+  return PostTask(std::move(task), times, period, time_provider_->Now(),
+                  priority, options);
 }
 
-TaskHandle RunLoopUi::PostDelayedTask(Task task, IntervalMs delay) {
-  return PostTask(std::move(task), 1, IntervalMs{0},
-                  time_provider_->Now() + delay);
+TaskHandle RunLoopUi::PostDelayedTask(Task task, IntervalNs delay,
+                                      TaskPriority priority,
+                                      TimerOptions options) {
+  return PostTask(std::move(task), 1, IntervalNs{0},
+                  time_provider_->Now() + delay, priority, options);
 }
 
 void RunLoopUi::CancelTask(TaskHandle&& handle) {
-  auto task_ptr = handle.task.lock();
-  if (std::lock_guard lock{task_quard_}; task_ptr) {
+  // Task state is destroyed out of lock, it may post or cancel tasks.
+  Task cancelled_task;
+
+  std::lock_guard lock{task_quard_};
+  auto* task_ptr = pool_.Find(handle);
+  if (!task_ptr) {
+    return;
+  }
+
+  if (task_ptr->is_in_lane) {
+    lanes_.Remove(task_ptr);
+    cancelled_task = std::move(task_ptr->task);
+    pool_.Release(task_ptr);
+    capacity_.Release(1);
+  } else if (task_ptr->queue_index != PendingTask::kNotQueued) {
+    queue_->RemoveTask(task_ptr);
+    cancelled_task = std::move(task_ptr->task);
+    pool_.Release(task_ptr);
+  } else {
+    // Task is running now.
     task_ptr->task = []() {};
     task_ptr->times = 0;
   }
 }
 
-TaskHandle RunLoopUi::PostTask(Task task, size_t times, IntervalMs period,
-                               TimestampMs when) {
-  TaskHandle handle;
+void RunLoopUi::UpdateTaskPriority(const TaskHandle& handle,
+                                   TaskPriority priority) {
+  std::lock_guard lock{task_quard_};
+  auto* task_ptr = pool_.Find(handle);
+  if (!task_ptr || task_ptr->priority == priority) {
+    return;
+  }
+
+  if (task_ptr->is_in_lane) {
+    lanes_.Remove(task_ptr);
+    task_ptr->priority = priority;
+    lanes_.Push(task_ptr);
+  } else {
+    task_ptr->priority = priority;
+  }
+}
+
+TaskHandle RunLoopUi::PostTask(Task task, size_t times, IntervalNs period,
+                               TimestampNs when, TaskPriority priority,
+                               TimerOptions options) {
+  auto* pending_task = pool_.Acquire(std::move(task), times, period, when,
+                                     priority, options);
+  TaskHandle handle{*pending_task};
   {
     std::unique_lock lock{task_quard_};
-    handle = queue_->AddTask(
-        std::make_shared<PendingTask>(std::move(task), times, period, when));
+    queue_->AddTask(pending_task);
+    WakeUpLocked();
   }
 
   return handle;
 }
 
-void RunLoopUi::PostTask(std::shared_ptr<PendingTask>&& task) {
+TaskHandle RunLoopUi::PostIdleTask(Task task, IntervalNs deadline) {
+  auto* pending_task =
+      pool_.Acquire(std::move(task), 1, IntervalNs{0},
+                    time_provider_->Now() + deadline,
+                    TaskPriority::kBackground);
+  TaskHandle handle{*pending_task};
   {
-    std::unique_lock lock{task_quard_};
-    queue_->AddTask(std::move(task));
+    std::lock_guard lock{task_quard_};
+    queue_->AddTask(pending_task);
+    idle_tasks_.push_back(handle);
+    WakeUpLocked();
+  }
+
+  return handle;
+}
+
+TaskHandle RunLoopUi::PostCoalescedTask(const std::string& key, Task task,
+                                        TaskPriority priority) {
+  // Task state is destroyed out of lock, it may post or cancel tasks.
+  Task replaced_task;
+  {
+    std::lock_guard coalesced_lock{coalesced_guard_};
+    std::lock_guard lock{task_quard_};
+    if (auto* task_ptr =
+            ReplaceCoalescedTaskLocked(key, task, priority, replaced_task)) {
+      return TaskHandle{*task_ptr};
+    }
+  }
+
+  // Poster may wait for capacity, so it is taken out of guards.
+  if (!AcquireCapacity()) {
+    return {};
+  }
+
+  TaskHandle handle;
+  auto is_replaced = false;
+  {
+    std::lock_guard coalesced_lock{coalesced_guard_};
+    std::lock_guard lock{task_quard_};
+    if (auto* task_ptr =
+            ReplaceCoalescedTaskLocked(key, task, priority, replaced_task)) {
+      // Task with the key has been posted meanwhile.
+      handle = TaskHandle{*task_ptr};
+      is_replaced = true;
+    } else {
+      auto* pending_task = pool_.Acquire(std::move(task), 1, IntervalNs{0},
+                                         time_provider_->Now(), priority);
+      handle = TaskHandle{*pending_task};
+      lanes_.Push(pending_task);
+      coalesced_tasks_[key] = handle;
+      WakeUpLocked();
+    }
   }
+
+  if (is_replaced) {
+    // Replaced task holds capacity already.
+    capacity_.Release(1);
+  }
+
+  return handle;
 }
 
 void RunLoopUi::SetBackendTask(BackendTask&& backend_task) {
   backend_task_ = std::move(backend_task);
 }
+
+void RunLoopUi::SetBackendWaiter(BackendWait&& wait, BackendWakeUp&& wake_up) {
+  backend_wait_ = std::move(wait);
+  backend_wake_up_ = std::move(wake_up);
+}
+
+bool RunLoopUi::AcquireCapacity() {
+  return capacity_.TryAcquire() ||
+         capacity_.Acquire(
+             current_loop == this, is_running_,
+             [this]() { return DropOldestTask(); },
+             [this]() {
+               std::lock_guard lock{task_quard_};
+               WakeUpLocked();
+             });
+}
+
+bool RunLoopUi::DropOldestTask() {
+  Task dropped_task;
+
+  std::lock_guard lock{task_quard_};
+  auto* task_ptr = lanes_.FindOldestOneShotTask();
+  if (!task_ptr) {
+    return false;
+  }
+
+  lanes_.Remove(task_ptr);
+  // Destroy task state out of lock, it may post or cancel tasks.
+  dropped_task = std::move(task_ptr->task);
+  pool_.Release(task_ptr);
+
+  return true;
+}
+
+PendingTask* RunLoopUi::ReplaceCoalescedTaskLocked(const std::string& key,
+                                                   Task& task,
+                                                   TaskPriority priority,
+                                                   Task& replaced_task) {
+  const auto it = coalesced_tasks_.find(key);
+  if (it == coalesced_tasks_.end()) {
+    return nullptr;
+  }
+
+  // Cancelled task leaves lanes, so task in lane is still pending.
+  auto* task_ptr = pool_.Find(it->second);
+  if (!task_ptr || !task_ptr->is_in_lane) {
+    return nullptr;
+  }
+
+  // Pending task keeps its place in lane and takes new work.
+  replaced_task = std::exchange(task_ptr->task, std::move(task));
+  if (task_ptr->priority != priority) {
+    lanes_.Remove(task_ptr);
+    task_ptr->priority = priority;
+    lanes_.Push(task_ptr);
+  }
+
+  return task_ptr;
+}
 }  // namespace mk
\ No newline at end of file
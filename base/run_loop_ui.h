@@ -1,27 +1,65 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 
 #include "dispatch_task.h"
 #include "pending_task.h"
+#include "pending_task_pool.h"
 #include "run_loop_backend_executor.h"
+#include "task_capacity.h"
+#include "task_lanes.h"
 #include "task_loop.h"
+#include "task_loop_metrics.h"
 
 namespace mk {
+class TaskHeartbeat;
 class TaskQueue;
 class TimeProvider;
 
+/**
+ * @brief UI run loop configuration.
+ *
+ */
+struct RunLoopUiOptions {
+  /// Time of every frame given to tasks before backend task renders.
+  IntervalNs frame_task_budget{IntervalMs{8}};
+
+  /// Most ready tasks waiting to start. Zero means unbounded.
+  std::size_t capacity{0};
+
+  OverflowPolicy overflow_policy{OverflowPolicy::kBlock};
+};
+
 /**
  * @brief Processes tasks for ui thread.
  *
+ * Every frame runs ready tasks until frame task budget is used, then the
+ * backend task. Ready tasks left and tasks posted while frame runs are
+ * deferred to next frames. Idle tasks run only in budget left when no ready
+ * task waits.
+ *
+ * Ready tasks of bounded loop are counted by TaskCapacity. Repeating tasks
+ * are never dropped.
+ *
+ * If backend task reports idle iteration, loop waits by backend waiter until
+ * backend event, next task call time or task posting.
+ *
+ * Loop doesn't sleep by itself, so with VirtualTimeProvider its waits are
+ * virtual if backend waiter advances the provider by given timeout instead
+ * of waiting. Frame task budget is measured by the provider too, so in
+ * virtual time it lasts until tasks advance time.
+ *
  */
 class RunLoopUi : public TaskLoop,
                   public DispatchTask,
                   public RunLoopBackendExecutor {
  public:
-  RunLoopUi(std::unique_ptr<TaskQueue> task_queue,
+  RunLoopUi(RunLoopUiOptions options, std::unique_ptr<TaskQueue> task_queue,
             std::unique_ptr<TimeProvider> time_provider);
 
   /** @see TaskLoop.*/
@@ -30,34 +68,173 @@ class RunLoopUi : public TaskLoop,
   /** @see TaskLoop. */
   void Stop() override;
 
+  /** @see TaskLoop. */
+  void SetWatchdog(TaskWatchdog& watchdog, const std::string& name) override;
+
+  /** @see TaskLoop. */
+  void SetMetrics(MetricsRegistry& registry, const std::string& name) override;
+
+  using DispatchTask::PostDelayedTask;
+  using DispatchTask::PostRepeatingTask;
+  using DispatchTask::PostTask;
+  using DispatchTask::PostTasks;
+
+  /** @see DispatchTask. */
+  TaskHandle PostTask(Task task, TaskPriority priority) override;
+
   /** @see DispatchTask. */
-  TaskHandle PostTask(Task task) override;
+  std::vector<TaskHandle> PostTasks(std::vector<Task> tasks,
+                                    TaskPriority priority) override;
 
   /** @see DispatchTask. */
-  TaskHandle PostRepeatingTask(Task task, size_t times,
-                               IntervalMs period) override;
+  TaskHandle PostRepeatingTask(Task task, size_t times, IntervalNs period,
+                               TaskPriority priority,
+                               TimerOptions options) override;
 
   /** @see DispatchTask. */
-  TaskHandle PostDelayedTask(Task task, IntervalMs delay) override;
+  TaskHandle PostDelayedTask(Task task, IntervalNs delay,
+                             TaskPriority priority,
+                             TimerOptions options) override;
 
   /** @see DispatchTask. */
   void CancelTask(TaskHandle&& handle) override;
 
+  /** @see DispatchTask. */
+  void UpdateTaskPriority(const TaskHandle& handle,
+                          TaskPriority priority) override;
+
   /** @see RunLoopBackendExecutor. */
   void SetBackendTask(BackendTask&& backend_task) override;
 
- private:
-  TaskHandle PostTask(Task task, size_t times, IntervalMs period,
-                      TimestampMs when);
-
-  void PostTask(std::shared_ptr<PendingTask>&& task);
+  /** @see RunLoopBackendExecutor. */
+  void SetBackendWaiter(BackendWait&& wait, BackendWakeUp&& wake_up) override;
+
+  /**
+   * @brief Post task to be run when frame has spare task budget.
+   *
+   * Idle tasks run in posting order. Task which hasn't found spare time
+   * until deadline runs as ordinary background task.
+   *
+   * @param task Task to be done.
+   * @param deadline Longest delay before task execution.
+   * @return Task handle.
+   */
+  TaskHandle PostIdleTask(Task task, IntervalNs deadline);
+
+  /**
+   * @brief Post immediate task replacing pending task with the same key.
+   *
+   * Replaced task never runs. Task which has started already isn't
+   * replaced. Every distinct key keeps small map entry while loop lives.
+   *
+   * @param key Coalescing key.
+   * @param task Task to be done.
+   * @param priority Task priority.
+   * @return Task handle. Empty if bounded loop rejects task.
+   */
+  TaskHandle PostCoalescedTask(const std::string& key, Task task,
+                               TaskPriority priority);
+
+  /** @brief Post user visible coalesced task. */
+  TaskHandle PostCoalescedTask(const std::string& key, Task task) {
+    return PostCoalescedTask(key, std::move(task), TaskPriority::kUserVisible);
+  }
 
+ private:
+  /**
+   * @brief Run ready tasks, then idle tasks, while budget lasts.
+   *
+   * @param lock Locked task guard.
+   * @param now Frame start time.
+   * @param stats Frame stats to count tasks in.
+   */
+  void RunTasks(std::unique_lock<std::mutex>& lock, TimestampNs now,
+                FrameStats& stats);
+
+  /**
+   * @brief Pop idle task still waiting for spare time.
+   *
+   * @return Idle task or nullptr.
+   */
+  PendingTask* PopIdleTask();
+
+  /**
+   * @brief Run task and requeue it if it repeats.
+   *
+   * @param lock Locked task guard, unlocked while task runs.
+   * @param pending_task Task taken out of lanes or queue.
+   * @return False if loop has been stopped by task.
+   */
+  bool RunTask(std::unique_lock<std::mutex>& lock, PendingTask* pending_task);
+
+  /**
+   * @brief Wait by backend until there is something to do.
+   *
+   */
+  void WaitForWork();
+
+  /**
+   * @brief Interrupt backend wait if loop waits. Must be called under task
+   * guard after task is added.
+   *
+   */
+  void WakeUpLocked();
+
+  TaskHandle PostTask(Task task, size_t times, IntervalNs period,
+                      TimestampNs when, TaskPriority priority,
+                      TimerOptions options);
+
+  /**
+   * @brief Take capacity for immediate task, applying overflow policy.
+   *
+   * @return false if task is rejected.
+   */
+  bool AcquireCapacity();
+
+  /**
+   * @brief Drop oldest ready task of lowest priority.
+   *
+   * @return true if new task may take capacity of dropped one.
+   */
+  bool DropOldestTask();
+
+  /**
+   * @brief Give new work to pending task with the key.
+   *
+   * @param key Coalescing key.
+   * @param task New work, moved from only if task is replaced.
+   * @param priority New priority.
+   * @param replaced_task Receives replaced work, so it is destroyed out of
+   * lock.
+   * @return Task which takes new work or nullptr.
+   */
+  PendingTask* ReplaceCoalescedTaskLocked(const std::string& key, Task& task,
+                                          TaskPriority priority,
+                                          Task& replaced_task);
+
+  PendingTaskPool pool_;
   std::unique_ptr<TaskQueue> queue_;
+  TaskLanes lanes_;
   std::unique_ptr<TimeProvider> time_provider_;
+  std::shared_ptr<TaskHeartbeat> heartbeat_;
+  TaskLoopMetrics metrics_;
+  const RunLoopUiOptions options_;
+
+  /// Idle tasks wait in queue until deadline, here is their idle order.
+  std::deque<TaskHandle> idle_tasks_;
 
   std::mutex task_quard_;
   std::atomic<bool> is_running_;
 
+  /// Tasks in lanes.
+  TaskCapacity capacity_;
+
+  std::mutex coalesced_guard_;
+  std::unordered_map<std::string, TaskHandle> coalesced_tasks_;
+
   RunLoopBackendExecutor::BackendTask backend_task_;
+  RunLoopBackendExecutor::BackendWait backend_wait_;
+  RunLoopBackendExecutor::BackendWakeUp backend_wake_up_;
+  std::atomic<bool> is_waiting_;
 };
 }  // namespace mk
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "sequenced_dispatch_task.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace mk {
+namespace {
+template <typename Entries>
+auto FindEntry(Entries& entries, std::uint32_t id) {
+  return std::find_if(entries.begin(), entries.end(),
+                      [id](const auto& entry) { return entry.id == id; });
+}
+}  // namespace
+
+SequencedDispatchTask::SequencedDispatchTask(
+    std::shared_ptr<DispatchTask> dispatcher)
+    : state_{std::make_shared<State>()} {
+  state_->dispatcher = std::move(dispatcher);
+}
+
+SequencedDispatchTask::~SequencedDispatchTask() {
+  Calls calls;
+  {
+    std::lock_guard lock{state_->guard};
+    for (auto& entry : state_->delayed_entries) {
+      StopFixedRate(entry, calls);
+    }
+    for (auto& entry : state_->ready_entries) {
+      StopFixedRate(entry, calls);
+    }
+    if (state_->running_entry) {
+      StopFixedRate(*state_->running_entry, calls);
+    }
+  }
+
+  MakeCalls(state_, calls);
+}
+
+TaskHandle SequencedDispatchTask::PostTask(Task task, TaskPriority priority) {
+  Calls calls;
+  TaskHandle handle;
+  {
+    std::lock_guard lock{state_->guard};
+
+    Entry entry;
+    entry.id = MakeId(*state_);
+    entry.task = std::move(task);
+    entry.priority = priority;
+
+    handle = TaskHandle::FromId(state_->owner, entry.id);
+    state_->ready_entries.push_back(std::move(entry));
+    ScheduleNext(*state_, calls);
+  }
+
+  MakeCalls(state_, calls);
+  return handle;
+}
+
+std::vector<TaskHandle> SequencedDispatchTask::PostTasks(
+    std::vector<Task> tasks, TaskPriority priority) {
+  std::vector<TaskHandle> handles;
+  handles.reserve(tasks.size());
+
+  Calls calls;
+  {
+    std::lock_guard lock{state_->guard};
+    for (auto& task : tasks) {
+      Entry entry;
+      entry.id = MakeId(*state_);
+      entry.task = std::move(task);
+      entry.priority = priority;
+
+      handles.push_back(TaskHandle::FromId(state_->owner, entry.id));
+      state_->ready_entries.push_back(std::move(entry));
+    }
+
+    ScheduleNext(*state_, calls);
+  }
+
+  MakeCalls(state_, calls);
+  return handles;
+}
+
+TaskHandle SequencedDispatchTask::PostRepeatingTask(Task task, size_t times,
+                                                    IntervalNs period,
+                                                    TaskPriority priority,
+                                                    TimerOptions options) {
+  Calls calls;
+  TaskHandle handle;
+  {
+    std::lock_guard lock{state_->guard};
+
+    Entry entry;
+    entry.id = MakeId(*state_);
+    entry.task = std::move(task);
+    entry.times = times;
+    entry.period = period;
+    entry.priority = priority;
+    entry.options = options;
+
+    handle = TaskHandle::FromId(state_->owner, entry.id);
+    if (options.repeat_mode == RepeatMode::kFixedRate && times > 1) {
+      EnqueueFixedRate(*state_, std::move(entry), calls);
+    } else {
+      state_->ready_entries.push_back(std::move(entry));
+    }
+    ScheduleNext(*state_, calls);
+  }
+
+  MakeCalls(state_, calls);
+  return handle;
+}
+
+TaskHandle SequencedDispatchTask::PostDelayedTask(Task task, IntervalNs delay,
+                                                  TaskPriority priority,
+                                                  TimerOptions options) {
+  Calls calls;
+  TaskHandle handle;
+  {
+    std::lock_guard lock{state_->guard};
+
+    Entry entry;
+    entry.id = MakeId(*state_);
+    entry.task = std::move(task);
+    entry.priority = priority;
+    entry.options = options;
+
+    handle = TaskHandle::FromId(state_->owner, entry.id);
+    EnqueueDelayed(*state_, std::move(entry), delay, calls);
+    ScheduleNext(*state_, calls);
+  }
+
+  MakeCalls(state_, calls);
+  return handle;
+}
+
+void SequencedDispatchTask::CancelTask(TaskHandle&& handle) {
+  if (handle.owner != state_->owner) {
+    return;
+  }
+
+  // Task state is destroyed out of lock, it may post to this sequence.
+  Entry cancelled_entry;
+  Calls calls;
+  {
+    std::lock_guard lock{state_->guard};
+    const auto id = handle.id;
+
+    auto& ready_entries = state_->ready_entries;
+    auto& delayed_entries = state_->delayed_entries;
+    if (auto it = FindEntry(ready_entries, id); it != ready_entries.end()) {
+      // Runner of removed front entry just runs the next one.
+      cancelled_entry = std::move(*it);
+      ready_entries.erase(it);
+      StopFixedRate(cancelled_entry, calls);
+    } else if (auto delayed_it = FindEntry(delayed_entries, id);
+               delayed_it != delayed_entries.end()) {
+      // Timer not stored yet is cancelled by its poster.
+      if (delayed_it->timer_handle.IsIssued()) {
+        calls.cancelled_handles.push_back(std::move(delayed_it->timer_handle));
+      }
+      cancelled_entry = std::move(*delayed_it);
+      delayed_entries.erase(delayed_it);
+    } else if (state_->running_entry && state_->running_entry->id == id) {
+      state_->is_running_cancelled = true;
+    }
+  }
+
+  MakeCalls(state_, calls);
+}
+
+void SequencedDispatchTask::UpdateTaskPriority(const TaskHandle& handle,
+                                               TaskPriority priority) {
+  if (handle.owner != state_->owner) {
+    return;
+  }
+
+  // Stale handle is ignored by underlying dispatcher.
+  TaskHandle underlying_handle;
+  {
+    std::lock_guard lock{state_->guard};
+    const auto id = handle.id;
+
+    auto& ready_entries = state_->ready_entries;
+    for (std::size_t i = 0; i < ready_entries.size(); ++i) {
+      if (ready_entries[i].id == id) {
+        ready_entries[i].priority = priority;
+        if (i == 0) {
+          underlying_handle = state_->runner_handle;
+        }
+        break;
+      }
+    }
+
+    for (auto& entry : state_->delayed_entries) {
+      if (entry.id == id) {
+        entry.priority = priority;
+        underlying_handle = entry.timer_handle;
+        break;
+      }
+    }
+  }
+
+  if (underlying_handle.IsIssued()) {
+    state_->dispatcher->UpdateTaskPriority(underlying_handle, priority);
+  }
+}
+
+std::uint32_t SequencedDispatchTask::MakeId(State& state) {
+  // 0 is reserved for empty handle.
+  if (++state.last_id == 0) {
+    ++state.last_id;
+  }
+
+  return state.last_id;
+}
+
+void SequencedDispatchTask::EnqueueDelayed(State& state, Entry entry,
+                                           IntervalNs delay, Calls& calls) {
+  if (delay <= IntervalNs{0}) {
+    state.ready_entries.push_back(std::move(entry));
+    return;
+  }
+
+  // Entry joins sequence when delay expires.
+  entry.timer_id = MakeId(state);
+  entry.timer_handle = TaskHandle{};
+  calls.timers.push_back({entry.id, entry.timer_id, false, delay,
+                          entry.priority, entry.options,
+                          entry.task.GetLocation()});
+
+  state.delayed_entries.push_back(std::move(entry));
+}
+
+void SequencedDispatchTask::EnqueueFixedRate(State& state, Entry entry,
+                                             Calls& calls) {
+  // Entry joins sequence on every beat unless it is still there.
+  entry.timer_id = MakeId(state);
+  entry.timer_handle = TaskHandle{};
+  calls.timers.push_back({entry.id, entry.timer_id, true, entry.period,
+                          entry.priority, entry.options,
+                          entry.task.GetLocation()});
+
+  state.delayed_entries.push_back(std::move(entry));
+}
+
+void SequencedDispatchTask::StopFixedRate(Entry& entry, Calls& calls) {
+  // Beat not stored yet is cancelled by its poster.
+  if (entry.options.repeat_mode == RepeatMode::kFixedRate &&
+      entry.timer_handle.IsIssued()) {
+    calls.cancelled_handles.push_back(std::move(entry.timer_handle));
+    entry.timer_handle = TaskHandle{};
+  }
+}
+
+void SequencedDispatchTask::ScheduleNext(State& state, Calls& calls) {
+  if (state.is_scheduled || state.ready_entries.empty()) {
+    return;
+  }
+
+  // Runner reports location of the entry it is going to run.
+  const auto& entry = state.ready_entries.front();
+  state.is_scheduled = true;
+  state.runner_id = MakeId(state);
+  state.runner_handle = TaskHandle{};
+
+  calls.runner_id = state.runner_id;
+  calls.runner_priority = entry.priority;
+  calls.runner_location = entry.task.GetLocation();
+}
+
+SequencedDispatchTask::Entry* SequencedDispatchTask::FindTimerEntry(
+    State& state, std::uint32_t id, std::uint32_t timer_id) {
+  const auto is_timer_entry = [id, timer_id](const Entry& entry) {
+    return entry.id == id && entry.timer_id == timer_id;
+  };
+
+  auto& delayed_entries = state.delayed_entries;
+  if (auto it = std::find_if(delayed_entries.begin(), delayed_entries.end(),
+                             is_timer_entry);
+      it != delayed_entries.end()) {
+    return &*it;
+  }
+
+  auto& ready_entries = state.ready_entries;
+  if (auto it = std::find_if(ready_entries.begin(), ready_entries.end(),
+                             is_timer_entry);
+      it != ready_entries.end()) {
+    return &*it;
+  }
+
+  if (state.running_entry && is_timer_entry(*state.running_entry)) {
+    return state.running_entry;
+  }
+
+  return nullptr;
+}
+
+void SequencedDispatchTask::MakeCalls(const std::shared_ptr<State>& state,
+                                      Calls& calls) {
+  auto& dispatcher = *state->dispatcher;
+  for (auto& handle : calls.cancelled_handles) {
+    dispatcher.CancelTask(std::move(handle));
+  }
+
+  for (const auto& timer : calls.timers) {
+    TaskHandle handle;
+    if (timer.is_beat) {
+      // Beat repeats until cancelled, so it doesn't keep sequence alive.
+      handle = dispatcher.PostRepeatingTask(
+          Task{[weak_state = std::weak_ptr<State>{state}, id = timer.entry_id,
+                timer_id = timer.timer_id]() {
+                 if (auto beat_state = weak_state.lock()) {
+                   OnTimer(beat_state, id, timer_id);
+                 }
+               },
+               timer.location},
+          std::numeric_limits<size_t>::max(), timer.delay, timer.priority,
+          timer.options);
+    } else {
+      handle = dispatcher.PostDelayedTask(
+          Task{[state, id = timer.entry_id, timer_id = timer.timer_id]() {
+                 OnTimer(state, id, timer_id);
+               },
+               timer.location},
+          timer.delay, timer.priority, timer.options);
+    }
+
+    // Entry may have been cancelled, finished or fired meanwhile.
+    Entry rejected_entry;
+    {
+      std::lock_guard lock{state->guard};
+      auto* entry = FindTimerEntry(*state, timer.entry_id, timer.timer_id);
+      if (entry && handle.IsIssued()) {
+        entry->timer_handle = handle;
+        handle = TaskHandle{};
+      } else if (entry) {
+        // Rejected timer never fires, so its entry is still delayed.
+        auto& delayed_entries = state->delayed_entries;
+        auto it = FindEntry(delayed_entries, timer.entry_id);
+        rejected_entry = std::move(*it);
+        delayed_entries.erase(it);
+      }
+    }
+
+    if (handle.IsIssued()) {
+      dispatcher.CancelTask(std::move(handle));
+    }
+  }
+
+  if (calls.runner_id == 0) {
+    return;
+  }
+
+  auto handle = dispatcher.PostTask(
+      Task{[state]() { RunNext(state); }, calls.runner_location},
+      calls.runner_priority);
+
+  std::lock_guard lock{state->guard};
+  if (state->runner_id != calls.runner_id) {
+    // Runner has already started.
+    return;
+  }
+
+  if (handle.IsIssued()) {
+    state->runner_handle = handle;
+  } else {
+    // Ready entries wait for the next posting to schedule them again.
+    state->is_scheduled = false;
+    state->runner_id = 0;
+  }
+}
+
+void SequencedDispatchTask::OnTimer(const std::shared_ptr<State>& state,
+                                    std::uint32_t id, std::uint32_t timer_id) {
+  Calls calls;
+  {
+    std::lock_guard lock{state->guard};
+
+    auto& delayed_entries = state->delayed_entries;
+    auto it = FindEntry(delayed_entries, id);
+    if (it == delayed_entries.end() || it->timer_id != timer_id) {
+      return;
+    }
+
+    state->ready_entries.push_back(std::move(*it));
+    delayed_entries.erase(it);
+    ScheduleNext(*state, calls);
+  }
+
+  MakeCalls(state, calls);
+}
+
+void SequencedDispatchTask::RunNext(const std::shared_ptr<State>& state) {
+  Entry entry;
+  {
+    std::lock_guard lock{state->guard};
+    state->runner_id = 0;
+    state->runner_handle = TaskHandle{};
+
+    if (state->ready_entries.empty()) {
+      // Front entry has been cancelled.
+      state->is_scheduled = false;
+      return;
+    }
+
+    entry = std::move(state->ready_entries.front());
+    state->ready_entries.pop_front();
+    state->running_entry = &entry;
+    state->is_running_cancelled = false;
+  }
+
+  entry.task();
+
+  Calls calls;
+  {
+    std::lock_guard lock{state->guard};
+    state->running_entry = nullptr;
+
+    if (!state->is_running_cancelled && entry.times > 1) {
+      --entry.times;
+      if (entry.options.repeat_mode == RepeatMode::kFixedRate) {
+        // Beat task is still running.
+        state->delayed_entries.push_back(std::move(entry));
+      } else {
+        const auto period = entry.period;
+        EnqueueDelayed(*state, std::move(entry), period, calls);
+      }
+    } else {
+      StopFixedRate(entry, calls);
+    }
+
+    state->is_scheduled = false;
+    ScheduleNext(*state, calls);
+  }
+
+  MakeCalls(state, calls);
+}
+}  // namespace mk
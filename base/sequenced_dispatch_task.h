@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "dispatch_task.h"
+
+namespace mk {
+/**
+ * @brief Runs tasks one by one in posting order on top of other dispatcher.
+ *
+ * Sequence never occupies a thread. Only the next task of sequence is posted
+ * to underlying dispatcher, so tasks of one sequence never run concurrently
+ * even on thread pool, while different sequences share its workers. Delayed
+ * tasks join sequence when their delay expires. Sequence is cheap to create,
+ * it is one shared block with a mutex and task queues, and no thread.
+ *
+ * Fixed rate task is driven by repeating task of underlying dispatcher which
+ * moves it to sequence on every beat. Beats coming while task still waits in
+ * sequence or runs are skipped.
+ *
+ * Underlying dispatcher keeps sequence alive while it has tasks, except
+ * beats, which stop with sequence. Underlying dispatcher is called out of
+ * sequence lock, so it may block or call sequence back. If it rejects
+ * sequence task, ready tasks wait for next posting and delayed task is
+ * dropped.
+ *
+ */
+class SequencedDispatchTask : public DispatchTask {
+ public:
+  explicit SequencedDispatchTask(std::shared_ptr<DispatchTask> dispatcher);
+
+  /**
+   * @brief Stop beats of fixed rate tasks. Other posted tasks still run.
+   *
+   */
+  ~SequencedDispatchTask() override;
+
+  using DispatchTask::PostDelayedTask;
+  using DispatchTask::PostRepeatingTask;
+  using DispatchTask::PostTask;
+  using DispatchTask::PostTasks;
+
+  /** @see DispatchTask. */
+  TaskHandle PostTask(Task task, TaskPriority priority) override;
+
+  /** @see DispatchTask. */
+  std::vector<TaskHandle> PostTasks(std::vector<Task> tasks,
+                                    TaskPriority priority) override;
+
+  /** @see DispatchTask. */
+  TaskHandle PostRepeatingTask(Task task, size_t times, IntervalNs period,
+                               TaskPriority priority,
+                               TimerOptions options) override;
+
+  /** @see DispatchTask. */
+  TaskHandle PostDelayedTask(Task task, IntervalNs delay,
+                             TaskPriority priority,
+                             TimerOptions options) override;
+
+  /** @see DispatchTask. */
+  void CancelTask(TaskHandle&& handle) override;
+
+  /** @see DispatchTask. */
+  void UpdateTaskPriority(const TaskHandle& handle,
+                          TaskPriority priority) override;
+
+ private:
+  /**
+   * @brief Task of sequence.
+   *
+   */
+  struct Entry {
+    std::uint32_t id{0};
+    Task task;
+    size_t times{1};
+    IntervalNs period{0};
+    TaskPriority priority{TaskPriority::kUserVisible};
+    TimerOptions options;
+    std::uint32_t timer_id{0};  ///< Id of last delayed or beat task posted.
+    TaskHandle timer_handle;    ///< Underlying delayed or beat task.
+  };
+
+  /**
+   * @brief Sequence data shared with tasks posted to underlying dispatcher.
+   *
+   */
+  struct State {
+    std::shared_ptr<DispatchTask> dispatcher;
+    const std::uint32_t owner{TaskHandle::MakeOwner()};  ///< Handles issuer.
+
+    std::mutex guard;
+    std::deque<Entry> ready_entries;
+    std::vector<Entry> delayed_entries;
+
+    bool is_scheduled{false};  ///< Next entry is posted or running.
+    std::uint32_t runner_id{0};  ///< Id of posted runner until it starts.
+    TaskHandle runner_handle;    ///< Underlying task of the next entry.
+
+    Entry* running_entry{nullptr};  ///< Entry taken out of queue to run.
+    bool is_running_cancelled{false};
+
+    std::uint32_t last_id{0};
+  };
+
+  /**
+   * @brief Underlying dispatcher calls collected under state guard.
+   *
+   */
+  struct Calls {
+    struct Timer {
+      std::uint32_t entry_id{0};
+      std::uint32_t timer_id{0};
+      bool is_beat{false};
+      IntervalNs delay{0};  ///< Delay or beat period.
+      TaskPriority priority{TaskPriority::kUserVisible};
+      TimerOptions options;
+      Location location;
+    };
+
+    std::vector<TaskHandle> cancelled_handles;
+    std::vector<Timer> timers;
+
+    std::uint32_t runner_id{0};  ///< Runner to post if not 0.
+    TaskPriority runner_priority{TaskPriority::kUserVisible};
+    Location runner_location;
+  };
+
+  // Called under state guard.
+  static std::uint32_t MakeId(State& state);
+  static void EnqueueDelayed(State& state, Entry entry, IntervalNs delay,
+                             Calls& calls);
+  static void EnqueueFixedRate(State& state, Entry entry, Calls& calls);
+  static void StopFixedRate(Entry& entry, Calls& calls);
+  static void ScheduleNext(State& state, Calls& calls);
+  static Entry* FindTimerEntry(State& state, std::uint32_t id,
+                               std::uint32_t timer_id);
+
+  /**
+   * @brief Make collected calls. Called out of state guard.
+   *
+   */
+  static void MakeCalls(const std::shared_ptr<State>& state, Calls& calls);
+
+  static void OnTimer(const std::shared_ptr<State>& state, std::uint32_t id,
+                      std::uint32_t timer_id);
+  static void RunNext(const std::shared_ptr<State>& state);
+
+  std::shared_ptr<State> state_;
+};
+}  // namespace mk
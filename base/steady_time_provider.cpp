@@ -1,8 +1,8 @@
 #include "steady_time_provider.h"
 
 namespace mk {
-TimestampMs SteadyTimeProvider::Now() const {
-  return std::chrono::duration_cast<TimestampMs>(
+TimestampNs SteadyTimeProvider::Now() const {
+  return std::chrono::duration_cast<TimestampNs>(
       std::chrono::steady_clock::now().time_since_epoch());
 }
 }  // namespace mk
\ No newline at end of file
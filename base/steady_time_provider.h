@@ -10,6 +10,6 @@ namespace mk {
 class SteadyTimeProvider : public TimeProvider {
  public:
   /** @see TimeProvider. */
-  TimestampMs Now() const override;
+  TimestampNs Now() const override;
 };
 }  // namespace mk
\ No newline at end of file
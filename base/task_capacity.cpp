@@ -0,0 +1,95 @@
+#include "task_capacity.h"
+
+namespace mk {
+TaskCapacity::TaskCapacity(std::size_t capacity,
+                           OverflowPolicy overflow_policy)
+    : capacity_{capacity},
+      overflow_policy_{overflow_policy},
+      ready_count_{0},
+      blocked_count_{0} {}
+
+bool TaskCapacity::TryAcquire() { return capacity_ == 0 || TryTake(); }
+
+bool TaskCapacity::Acquire(bool is_loop_thread,
+                           const std::atomic<bool>& is_running,
+                           const std::function<bool()>& drop_oldest,
+                           const std::function<void()>& wake_up) {
+  if (TryAcquire()) {
+    return true;
+  }
+
+  switch (overflow_policy_) {
+    case OverflowPolicy::kReject:
+      return false;
+
+    case OverflowPolicy::kDropOldest:
+      if (!drop_oldest()) {
+        ++ready_count_;
+      }
+      return true;
+
+    case OverflowPolicy::kBlock:
+      break;
+  }
+
+  if (is_loop_thread || !is_running) {
+    // Loop can't wait for itself, stopped loop never frees capacity.
+    ++ready_count_;
+    return true;
+  }
+
+  wake_up();
+
+  std::unique_lock lock{guard_};
+  ++blocked_count_;
+  auto is_acquired = false;
+  event_.wait(lock, [this, &is_running, &is_acquired]() {
+    is_acquired = TryTake();
+    return is_acquired || !is_running;
+  });
+  --blocked_count_;
+
+  if (!is_acquired) {
+    // Loop has been stopped.
+    ++ready_count_;
+  }
+
+  return true;
+}
+
+void TaskCapacity::Add(std::size_t count) {
+  if (capacity_ != 0 && count != 0) {
+    ready_count_ += count;
+  }
+}
+
+void TaskCapacity::Release(std::size_t count) {
+  if (capacity_ == 0 || count == 0) {
+    return;
+  }
+
+  ready_count_ -= count;
+
+  // Poster increments blocked_count_ before it checks capacity, so either
+  // it sees released capacity or it is notified.
+  WakeUpBlocked();
+}
+
+void TaskCapacity::WakeUpBlocked() {
+  if (blocked_count_ != 0) {
+    std::lock_guard lock{guard_};
+    event_.notify_all();
+  }
+}
+
+bool TaskCapacity::TryTake() {
+  auto count = ready_count_.load(std::memory_order_relaxed);
+  do {
+    if (count >= capacity_) {
+      return false;
+    }
+  } while (!ready_count_.compare_exchange_weak(count, count + 1));
+
+  return true;
+}
+}  // namespace mk
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+namespace mk {
+/**
+ * @brief What bounded loop does with task posted when it is full.
+ *
+ */
+enum class OverflowPolicy {
+  kBlock,       ///< Poster waits until loop starts some task.
+  kReject,      ///< Task is destroyed, returned handle is not issued.
+  kDropOldest,  ///< Oldest ready task of lowest priority is cancelled.
+};
+
+/**
+ * @brief Ready tasks count of bounded loop.
+ *
+ * Loop counts immediate tasks from posting and delayed tasks from the moment
+ * they become ready, until they start or are removed. Only immediate posts
+ * are checked against capacity. Loop thread and loop which isn't running are
+ * never blocked, they exceed capacity instead. If nothing can be dropped,
+ * capacity is exceeded as well. Zero capacity means unbounded loop, which
+ * counts nothing.
+ *
+ */
+class TaskCapacity {
+ public:
+  /**
+   * @param capacity Most ready tasks waiting to start. Zero means unbounded.
+   * @param overflow_policy What to do with task posted when loop is full.
+   */
+  TaskCapacity(std::size_t capacity, OverflowPolicy overflow_policy);
+
+  TaskCapacity(const TaskCapacity&) = delete;
+  TaskCapacity& operator=(const TaskCapacity&) = delete;
+
+  /**
+   * @brief Take capacity if loop isn't full. Never blocks.
+   *
+   * @return true if capacity is taken or loop is unbounded.
+   */
+  bool TryAcquire();
+
+  /**
+   * @brief Take capacity for immediate task, applying overflow policy.
+   *
+   * @param is_loop_thread Task is posted by loop thread.
+   * @param is_running Loop state, blocked poster gives up when loop stops.
+   * @param drop_oldest Drop oldest ready task. Returns false if no task can
+   * be dropped.
+   * @param wake_up Wake loop up before poster blocks, so it takes tasks
+   * posted by the poster so far.
+   * @return false if task is rejected.
+   */
+  bool Acquire(bool is_loop_thread, const std::atomic<bool>& is_running,
+               const std::function<bool()>& drop_oldest,
+               const std::function<void()>& wake_up);
+
+  /**
+   * @brief Count delayed tasks which became ready.
+   *
+   * @param count Tasks count.
+   */
+  void Add(std::size_t count);
+
+  /**
+   * @brief Free capacity of tasks which started or were removed.
+   *
+   * @param count Tasks count.
+   */
+  void Release(std::size_t count);
+
+  /**
+   * @brief Let blocked posters see that loop has been stopped.
+   *
+   */
+  void WakeUpBlocked();
+
+ private:
+  bool TryTake();
+
+  const std::size_t capacity_;
+  const OverflowPolicy overflow_policy_;
+
+  /// Tasks counted as ready. Counted only if loop is bounded.
+  std::atomic<std::size_t> ready_count_;
+  std::atomic<std::size_t> blocked_count_;
+  std::mutex guard_;
+  std::condition_variable event_;
+};
+}  // namespace mk
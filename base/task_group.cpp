@@ -0,0 +1,258 @@
+#include "task_group.h"
+
+#include <utility>
+
+namespace mk {
+/**
+ * @brief Task of group. Skips its task if group is cancelled and makes group
+ * forget it when destroyed, whether it has run or not.
+ *
+ */
+class TaskGroup::GroupedTask {
+ public:
+  GroupedTask(std::shared_ptr<State> state, std::uint32_t id, Task task)
+      : state_{std::move(state)}, id_{id}, task_{std::move(task)} {}
+
+  ~GroupedTask() {
+    if (state_) {
+      std::lock_guard lock{state_->guard};
+      state_->entries.erase(id_);
+    }
+  }
+
+  GroupedTask(GroupedTask&& other) noexcept = default;
+  GroupedTask& operator=(GroupedTask&&) = delete;
+
+  void operator()() {
+    if (!state_->is_cancelled.load(std::memory_order_acquire)) {
+      task_();
+    }
+  }
+
+ private:
+  std::shared_ptr<State> state_;
+  std::uint32_t id_;
+  Task task_;
+};
+
+/**
+ * @brief Posts tasks to underlying dispatcher as group tasks.
+ *
+ * Handles are group task ids tagged with dispatcher owner id, so other
+ * dispatchers, including other group dispatchers, ignore them.
+ *
+ */
+class TaskGroup::GroupedDispatchTask : public DispatchTask {
+ public:
+  GroupedDispatchTask(std::shared_ptr<State> state,
+                      std::shared_ptr<DispatchTask> dispatcher)
+      : state_{std::move(state)},
+        dispatcher_{std::move(dispatcher)},
+        owner_{TaskHandle::MakeOwner()} {}
+
+  using DispatchTask::PostDelayedTask;
+  using DispatchTask::PostRepeatingTask;
+  using DispatchTask::PostTask;
+  using DispatchTask::PostTasks;
+
+  /** @see DispatchTask. */
+  TaskHandle PostTask(Task task, TaskPriority priority) override {
+    return Post(std::move(task), [this, priority](Task grouped_task) {
+      return dispatcher_->PostTask(std::move(grouped_task), priority);
+    });
+  }
+
+  /** @see DispatchTask. */
+  std::vector<TaskHandle> PostTasks(std::vector<Task> tasks,
+                                    TaskPriority priority) override {
+    std::vector<TaskHandle> handles(tasks.size());
+    std::vector<std::uint32_t> ids;
+    ids.reserve(tasks.size());
+    {
+      std::lock_guard lock{state_->guard};
+      if (state_->is_cancelled.load(std::memory_order_relaxed)) {
+        return handles;
+      }
+
+      for (std::size_t i = 0; i < tasks.size(); ++i) {
+        ids.push_back(JoinLocked());
+      }
+    }
+
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+      tasks[i] = MakeGroupedTask(ids[i], std::move(tasks[i]));
+      handles[i] = TaskHandle::FromId(owner_, ids[i]);
+    }
+
+    auto dispatcher_handles =
+        dispatcher_->PostTasks(std::move(tasks), priority);
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      SetHandle(ids[i], dispatcher_handles[i]);
+    }
+
+    return handles;
+  }
+
+  /** @see DispatchTask. */
+  TaskHandle PostRepeatingTask(Task task, size_t times, IntervalNs period,
+                               TaskPriority priority,
+                               TimerOptions options) override {
+    return Post(std::move(task), [&](Task grouped_task) {
+      return dispatcher_->PostRepeatingTask(std::move(grouped_task), times,
+                                            period, priority, options);
+    });
+  }
+
+  /** @see DispatchTask. */
+  TaskHandle PostDelayedTask(Task task, IntervalNs delay,
+                             TaskPriority priority,
+                             TimerOptions options) override {
+    return Post(std::move(task), [&](Task grouped_task) {
+      return dispatcher_->PostDelayedTask(std::move(grouped_task), delay,
+                                          priority, options);
+    });
+  }
+
+  /** @see DispatchTask. */
+  void CancelTask(TaskHandle&& handle) override {
+    if (handle.owner != owner_) {
+      return;
+    }
+
+    TaskHandle dispatcher_handle;
+    {
+      std::lock_guard lock{state_->guard};
+      auto it = state_->entries.find(handle.id);
+      if (it == state_->entries.end()) {
+        return;
+      }
+
+      // Task being posted is cancelled once underlying post returns.
+      dispatcher_handle = it->second.handle;
+      state_->entries.erase(it);
+    }
+
+    if (dispatcher_handle.IsIssued()) {
+      dispatcher_->CancelTask(std::move(dispatcher_handle));
+    }
+  }
+
+  /** @see DispatchTask. */
+  void UpdateTaskPriority(const TaskHandle& handle,
+                          TaskPriority priority) override {
+    if (handle.owner != owner_) {
+      return;
+    }
+
+    TaskHandle dispatcher_handle;
+    {
+      std::lock_guard lock{state_->guard};
+      auto it = state_->entries.find(handle.id);
+      if (it == state_->entries.end()) {
+        return;
+      }
+
+      dispatcher_handle = it->second.handle;
+    }
+
+    if (dispatcher_handle.IsIssued()) {
+      dispatcher_->UpdateTaskPriority(dispatcher_handle, priority);
+    }
+  }
+
+ private:
+  /**
+   * @brief Post task to underlying dispatcher unless group is cancelled.
+   *
+   * Underlying dispatcher is called out of group guard, it may block on full
+   * loop or run cancelled tasks destructors.
+   *
+   */
+  template <typename PostGroupedTask>
+  TaskHandle Post(Task task, PostGroupedTask post) {
+    std::uint32_t id = 0;
+    {
+      std::lock_guard lock{state_->guard};
+      if (state_->is_cancelled.load(std::memory_order_relaxed)) {
+        return TaskHandle{};
+      }
+
+      id = JoinLocked();
+    }
+
+    SetHandle(id, post(MakeGroupedTask(id, std::move(task))));
+
+    return TaskHandle::FromId(owner_, id);
+  }
+
+  // Called under state guard.
+  std::uint32_t JoinLocked() {
+    // 0 is reserved for empty handle.
+    if (++state_->last_id == 0) {
+      ++state_->last_id;
+    }
+
+    state_->entries[state_->last_id] = Entry{dispatcher_, TaskHandle{}};
+
+    return state_->last_id;
+  }
+
+  Task MakeGroupedTask(std::uint32_t id, Task task) {
+    const auto location = task.GetLocation();
+    return Task{GroupedTask{state_, id, std::move(task)}, location};
+  }
+
+  void SetHandle(std::uint32_t id, TaskHandle dispatcher_handle) {
+    {
+      std::lock_guard lock{state_->guard};
+      if (auto it = state_->entries.find(id); it != state_->entries.end()) {
+        it->second.handle = dispatcher_handle;
+        return;
+      }
+    }
+
+    // Group or task has been cancelled while it was posted, or task is
+    // already done and handle is ignored.
+    if (dispatcher_handle.IsIssued()) {
+      dispatcher_->CancelTask(std::move(dispatcher_handle));
+    }
+  }
+
+  std::shared_ptr<State> state_;
+  std::shared_ptr<DispatchTask> dispatcher_;
+  const std::uint32_t owner_;
+};
+
+TaskGroup::TaskGroup() : state_{std::make_shared<State>()} {}
+
+TaskGroup::~TaskGroup() { Cancel(); }
+
+std::shared_ptr<DispatchTask> TaskGroup::Bind(
+    std::shared_ptr<DispatchTask> dispatcher) {
+  return std::make_shared<GroupedDispatchTask>(state_, std::move(dispatcher));
+}
+
+void TaskGroup::Cancel() {
+  std::unordered_map<std::uint32_t, Entry> entries;
+  {
+    std::lock_guard lock{state_->guard};
+    state_->is_cancelled.store(true, std::memory_order_release);
+    entries.swap(state_->entries);
+  }
+
+  // Cancelled tasks destructors take group guard.
+  for (auto& [id, entry] : entries) {
+    if (!entry.handle.IsIssued()) {
+      continue;
+    }
+
+    if (auto dispatcher = entry.dispatcher.lock()) {
+      dispatcher->CancelTask(std::move(entry.handle));
+    }
+  }
+}
+
+bool TaskGroup::IsCancelled() const {
+  return state_->is_cancelled.load(std::memory_order_acquire);
+}
+}  // namespace mk
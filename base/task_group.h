@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "dispatch_task.h"
+
+namespace mk {
+/**
+ * @brief Scope of related tasks posted to several dispatchers, e.g. reads,
+ * decodes and UI replies of one selection.
+ *
+ * Tasks join group by posting to dispatcher returned by Bind(). Cancel()
+ * cancels every group task which hasn't started on its dispatcher, it takes
+ * time proportional to the number of such tasks only. Task dequeued just
+ * before cancellation is dropped when it comes to run, and tasks posted to
+ * cancelled group are dropped at once. So work which is already running,
+ * e.g. decode posting its reply, can't resurrect cancelled group.
+ *
+ * Group forgets task when dispatcher runs or destroys it. Destroying group
+ * cancels it.
+ *
+ */
+class TaskGroup {
+ public:
+  TaskGroup();
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  /**
+   * @brief Get dispatcher posting tasks to given dispatcher in this group.
+   *
+   * Returned dispatcher doesn't keep group alive.
+   *
+   * @param dispatcher Dispatcher to run tasks on.
+   * @return Group dispatcher.
+   */
+  std::shared_ptr<DispatchTask> Bind(std::shared_ptr<DispatchTask> dispatcher);
+
+  /**
+   * @brief Drop every group task which hasn't started yet. May be called from
+   * any thread.
+   *
+   */
+  void Cancel();
+
+  bool IsCancelled() const;
+
+ private:
+  class GroupedDispatchTask;
+  class GroupedTask;
+
+  /**
+   * @brief Group task posted to underlying dispatcher.
+   *
+   */
+  struct Entry {
+    std::weak_ptr<DispatchTask> dispatcher;
+    TaskHandle handle;  ///< Empty until underlying post returns.
+  };
+
+  /**
+   * @brief Group data shared with group dispatchers and tasks.
+   *
+   */
+  struct State {
+    std::atomic<bool> is_cancelled{false};
+
+    std::mutex guard;
+    std::unordered_map<std::uint32_t, Entry> entries;
+    std::uint32_t last_id{0};
+  };
+
+  std::shared_ptr<State> state_;
+};
+}  // namespace mk
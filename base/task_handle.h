@@ -1,18 +1,69 @@
 #pragma once
 
-#include <memory>
+#include <atomic>
+#include <cstdint>
 
 #include "pending_task.h"
 
 namespace mk {
+/**
+ * @brief Pending task reference checked by slot generation.
+ *
+ * Handle stays valid after task is done. Dispatcher ignores handle if slot
+ * has been reused by another task or if handle has been issued by another
+ * dispatcher. Issuers without slot pool (task groups, sequences, pipelines)
+ * refer to their tasks by id instead of slot and generation.
+ *
+ */
 struct TaskHandle {
-  TaskHandle() : TaskHandle{nullptr} {}
+  TaskHandle() = default;
 
-  explicit TaskHandle(const std::shared_ptr<PendingTask>& pending_task)
-      : task{pending_task} {}
+  explicit TaskHandle(const PendingTask& pending_task)
+      : owner{pending_task.owner},
+        slot{pending_task.slot},
+        generation{pending_task.generation} {}
 
-  operator bool() const { return static_cast<bool>(task.lock()); }
+  /**
+   * @brief Make handle of issuer which tracks tasks by own ids.
+   *
+   * @param task_owner Id of issuer from MakeOwner().
+   * @param task_id Non-zero id of task among tasks of issuer.
+   */
+  static TaskHandle FromId(std::uint32_t task_owner, std::uint32_t task_id) {
+    TaskHandle handle;
+    handle.owner = task_owner;
+    handle.id = task_id;
+    return handle;
+  }
 
-  std::weak_ptr<PendingTask> task;
+  /**
+   * @brief Generate process unique id of handles issuer.
+   *
+   * @return Non-zero owner id.
+   */
+  static std::uint32_t MakeOwner() {
+    static std::atomic<std::uint32_t> last_owner{0};
+
+    auto new_owner = ++last_owner;
+    // 0 is reserved for empty handle.
+    while (new_owner == 0) {
+      new_owner = ++last_owner;
+    }
+
+    return new_owner;
+  }
+
+  /**
+   * @brief Tell if handle has been issued for some task.
+   *
+   * Issued handle may refer to task which is already done, only its issuer
+   * can tell if task is still pending.
+   */
+  bool IsIssued() const { return generation != 0 || id != 0; }
+
+  std::uint32_t owner{0};  ///< Id of dispatcher or pool which issued handle.
+  std::uint32_t slot{0};        ///< Slot of task in PendingTaskPool.
+  std::uint32_t generation{0};  ///< Generation of slot in PendingTaskPool.
+  std::uint32_t id{0};  ///< Task id given by FromId(), 0 for pooled tasks.
 };
 }  // namespace mk
\ No newline at end of file
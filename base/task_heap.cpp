@@ -0,0 +1,86 @@
+#include "task_heap.h"
+
+#include <cassert>
+
+namespace mk {
+void TaskHeap::Push(PendingTask* task) {
+  tasks_.push_back(task);
+  SiftUp(tasks_.size() - 1);
+}
+
+void TaskHeap::Remove(PendingTask* task) {
+  assert(task->queue_index < tasks_.size() &&
+         tasks_[task->queue_index] == task &&
+         "Remove(). Task is not in TaskHeap.");
+
+  const auto index = task->queue_index;
+  auto* last = tasks_.back();
+  tasks_.pop_back();
+  task->queue_index = PendingTask::kNotQueued;
+
+  if (last == task) {
+    return;
+  }
+
+  Place(last, index);
+  if (index > 0 && last->next_call < tasks_[(index - 1) / 2]->next_call) {
+    SiftUp(index);
+  } else {
+    SiftDown(index);
+  }
+}
+
+PendingTask* TaskHeap::GetTop() const {
+  assert(!IsEmpty() && "GetTop(). TaskHeap is empty.");
+
+  return tasks_.front();
+}
+
+bool TaskHeap::IsEmpty() const { return tasks_.empty(); }
+
+void TaskHeap::SiftUp(std::size_t index) {
+  auto* task = tasks_[index];
+
+  while (index > 0) {
+    const auto parent = (index - 1) / 2;
+    if (tasks_[parent]->next_call <= task->next_call) {
+      break;
+    }
+
+    Place(tasks_[parent], index);
+    index = parent;
+  }
+
+  Place(task, index);
+}
+
+void TaskHeap::SiftDown(std::size_t index) {
+  auto* task = tasks_[index];
+
+  while (true) {
+    auto child = index * 2 + 1;
+    if (child >= tasks_.size()) {
+      break;
+    }
+
+    if (child + 1 < tasks_.size() &&
+        tasks_[child + 1]->next_call < tasks_[child]->next_call) {
+      ++child;
+    }
+
+    if (task->next_call <= tasks_[child]->next_call) {
+      break;
+    }
+
+    Place(tasks_[child], index);
+    index = child;
+  }
+
+  Place(task, index);
+}
+
+void TaskHeap::Place(PendingTask* task, std::size_t index) {
+  tasks_[index] = task;
+  task->queue_index = index;
+}
+}  // namespace mk
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "pending_task.h"
+
+namespace mk {
+/**
+ * @brief Binary min-heap of tasks ordered by call time.
+ *
+ * Heap keeps position of every task in PendingTask::queue_index, so any task
+ * is removed in O(log n). Not thread safe.
+ *
+ */
+class TaskHeap {
+ public:
+  /**
+   * @brief Add task to heap.
+   *
+   * @param task Task to be added.
+   */
+  void Push(PendingTask* task);
+
+  /**
+   * @brief Remove task from heap.
+   *
+   * @param task Task added with Push() and not removed yet.
+   */
+  void Remove(PendingTask* task);
+
+  /**
+   * @brief Get task with the earliest call time.
+   *
+   * @return Task. Heap must not be empty.
+   */
+  PendingTask* GetTop() const;
+
+  /**
+   * @brief Tell if heap is empty.
+   *
+   * @return true if heap is empty. Otherwise false.
+   */
+  bool IsEmpty() const;
+
+ private:
+  void SiftUp(std::size_t index);
+  void SiftDown(std::size_t index);
+  void Place(PendingTask* task, std::size_t index);
+
+  std::vector<PendingTask*> tasks_;
+};
+}  // namespace mk
@@ -0,0 +1,118 @@
+#include "task_lanes.h"
+
+#include <cassert>
+
+namespace mk {
+std::size_t LaneSelector::Select(unsigned non_empty_lanes) {
+  auto selected = kTaskPrioritiesCount;
+
+  for (std::size_t i = 0; i < kTaskPrioritiesCount; ++i) {
+    if ((non_empty_lanes & (1u << i)) == 0) {
+      continue;
+    }
+
+    if (selected == kTaskPrioritiesCount ||
+        skipped_counts_[i] >= kMaxSkippedCount) {
+      selected = i;
+    }
+
+    if (skipped_counts_[i] >= kMaxSkippedCount) {
+      // Starving lane gets its turn.
+      break;
+    }
+  }
+
+  for (std::size_t i = 0; i < kTaskPrioritiesCount; ++i) {
+    if (i == selected) {
+      skipped_counts_[i] = 0;
+    } else if ((non_empty_lanes & (1u << i)) != 0) {
+      ++skipped_counts_[i];
+    }
+  }
+
+  return selected;
+}
+
+void TaskLanes::Push(PendingTask* task) {
+  assert(!task->is_in_lane && "Push(). Task is already in lane.");
+
+  auto& lane = lanes_[ToIndex(task->priority)];
+  task->lane_prev = lane.tail;
+  task->lane_next = nullptr;
+  task->is_in_lane = true;
+
+  if (lane.tail != nullptr) {
+    lane.tail->lane_next = task;
+  } else {
+    lane.head = task;
+  }
+  lane.tail = task;
+  ++size_;
+}
+
+PendingTask* TaskLanes::Pop() {
+  unsigned non_empty_lanes = 0;
+  for (std::size_t i = 0; i < kTaskPrioritiesCount; ++i) {
+    if (lanes_[i].head != nullptr) {
+      non_empty_lanes |= 1u << i;
+    }
+  }
+
+  const auto index = selector_.Select(non_empty_lanes);
+  if (index == kTaskPrioritiesCount) {
+    return nullptr;
+  }
+
+  auto* task = lanes_[index].head;
+  Remove(task);
+
+  return task;
+}
+
+void TaskLanes::Remove(PendingTask* task) {
+  assert(task->is_in_lane && "Remove(). Task is not in lane.");
+
+  auto& lane = lanes_[ToIndex(task->priority)];
+
+  if (task->lane_prev != nullptr) {
+    task->lane_prev->lane_next = task->lane_next;
+  } else {
+    lane.head = task->lane_next;
+  }
+
+  if (task->lane_next != nullptr) {
+    task->lane_next->lane_prev = task->lane_prev;
+  } else {
+    lane.tail = task->lane_prev;
+  }
+
+  task->lane_prev = nullptr;
+  task->lane_next = nullptr;
+  task->is_in_lane = false;
+  --size_;
+}
+
+PendingTask* TaskLanes::FindOldestOneShotTask() const {
+  for (auto index = kTaskPrioritiesCount; index-- > 0;) {
+    for (auto* task = lanes_[index].head; task; task = task->lane_next) {
+      if (task->times <= 1) {
+        return task;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+bool TaskLanes::IsEmpty() const {
+  for (const auto& lane : lanes_) {
+    if (lane.head != nullptr) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::size_t TaskLanes::GetSize() const { return size_; }
+}  // namespace mk
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "pending_task.h"
+#include "task_priority.h"
+
+namespace mk {
+/**
+ * @brief Chooses priority lane to take next task from.
+ *
+ * Highest priority non-empty lane wins unless lower priority lane has been
+ * skipped kMaxSkippedCount times in a row.
+ *
+ */
+class LaneSelector {
+ public:
+  static constexpr std::size_t kMaxSkippedCount = 8;
+
+  /**
+   * @brief Select lane.
+   *
+   * @param non_empty_lanes Bit N is set if lane N has tasks.
+   * @return Lane index or kTaskPrioritiesCount if all lanes are empty.
+   */
+  std::size_t Select(unsigned non_empty_lanes);
+
+ private:
+  std::array<std::size_t, kTaskPrioritiesCount> skipped_counts_{};
+};
+
+/**
+ * @brief Ready tasks split by priority.
+ *
+ * Every lane is intrusive FIFO list, so tasks can be removed or moved to
+ * another lane in O(1). Not thread safe.
+ *
+ */
+class TaskLanes {
+ public:
+  /**
+   * @brief Append task to lane of its priority.
+   *
+   * @param task Task to be added.
+   */
+  void Push(PendingTask* task);
+
+  /**
+   * @brief Pop next task according to lane priorities.
+   *
+   * @return Task or nullptr if all lanes are empty.
+   */
+  PendingTask* Pop();
+
+  /**
+   * @brief Remove task from its lane.
+   *
+   * @param task Task added with Push() and not popped yet.
+   */
+  void Remove(PendingTask* task);
+
+  /**
+   * @brief Find oldest task of lowest priority which doesn't repeat.
+   *
+   * @return Task or nullptr if there is no such task.
+   */
+  PendingTask* FindOldestOneShotTask() const;
+
+  /**
+   * @brief Tell if all lanes are empty.
+   *
+   * @return true if there is no tasks. Otherwise false.
+   */
+  bool IsEmpty() const;
+
+  /**
+   * @brief Get amount of tasks in all lanes.
+   *
+   */
+  std::size_t GetSize() const;
+
+ private:
+  struct Lane {
+    PendingTask* head{nullptr};
+    PendingTask* tail{nullptr};
+  };
+
+  std::array<Lane, kTaskPrioritiesCount> lanes_;
+  LaneSelector selector_;
+  std::size_t size_{0};
+};
+}  // namespace mk
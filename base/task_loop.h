@@ -1,6 +1,11 @@
 #pragma once
 
+#include <string>
+
 namespace mk {
+class MetricsRegistry;
+class TaskWatchdog;
+
 /**
  * @brief Message loop interface.
  *
@@ -20,5 +25,24 @@ class TaskLoop {
    *
    */
   virtual void Stop() = 0;
+
+  /**
+   * @brief Heartbeat watchdog around every task. Must be called before
+   * Run().
+   *
+   * @param watchdog Watchdog.
+   * @param name Loop name used in reports.
+   */
+  virtual void SetWatchdog(TaskWatchdog& watchdog, const std::string& name) = 0;
+
+  /**
+   * @brief Count run tasks and publish pending tasks count. Must be called
+   * before Run().
+   *
+   * @param registry Registry to create loop series in.
+   * @param name Loop name used as series label.
+   */
+  virtual void SetMetrics(MetricsRegistry& registry,
+                          const std::string& name) = 0;
 };
 }  // namespace mk
\ No newline at end of file
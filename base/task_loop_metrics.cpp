@@ -0,0 +1,35 @@
+#include "task_loop_metrics.h"
+
+namespace mk {
+TaskLoopMetrics::TaskLoopMetrics()
+    : tasks_run_{nullptr},
+      ready_tasks_{nullptr},
+      frame_tasks_time_{nullptr},
+      frame_backend_time_{nullptr},
+      deferred_tasks_{nullptr} {}
+
+TaskLoopMetrics::TaskLoopMetrics(MetricsRegistry& registry,
+                                 const std::string& loop_name)
+    : tasks_run_{&registry.GetCounter("mk_tasks_run_total",
+                                      "Tasks run by loop.",
+                                      {{"loop", loop_name}})},
+      ready_tasks_{&registry.GetGauge(
+          "mk_ready_tasks", "Ready tasks waiting in loop, sampled after run.",
+          {{"loop", loop_name}})},
+      frame_tasks_time_{nullptr},
+      frame_backend_time_{nullptr},
+      deferred_tasks_{nullptr} {}
+
+void TaskLoopMetrics::AddFrameSeries(MetricsRegistry& registry,
+                                     const std::string& loop_name) {
+  frame_tasks_time_ = &registry.GetHistogram(
+      "mk_frame_tasks_microseconds", "Time spent running tasks per frame.",
+      {{"loop", loop_name}});
+  frame_backend_time_ = &registry.GetHistogram(
+      "mk_frame_backend_microseconds", "Time spent in backend task per frame.",
+      {{"loop", loop_name}});
+  deferred_tasks_ = &registry.GetGauge(
+      "mk_deferred_tasks", "Ready tasks left to next frame.",
+      {{"loop", loop_name}});
+}
+}  // namespace mk
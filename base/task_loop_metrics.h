@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "metrics.h"
+#include "time_types.h"
+
+namespace mk {
+/**
+ * @brief Frame time split between tasks and backend task.
+ *
+ */
+struct FrameStats {
+  IntervalNs tasks_time{0};    ///< Time spent running tasks.
+  IntervalNs backend_time{0};  ///< Time spent in backend task (rendering).
+  std::size_t tasks_count{0};  ///< Tasks run including idle ones.
+  std::size_t deferred_tasks_count{0};  ///< Ready tasks left to next frames.
+};
+
+/**
+ * @brief Metrics of one task loop: run tasks total and ready tasks count,
+ * and frame times of loops which run tasks by frames.
+ *
+ */
+class TaskLoopMetrics {
+ public:
+  /**
+   * @brief Create disabled metrics, which record nothing.
+   *
+   */
+  TaskLoopMetrics();
+
+  /**
+   * @brief Create series of loop.
+   *
+   * @param registry Registry to create series in.
+   * @param loop_name Value of "loop" label.
+   */
+  TaskLoopMetrics(MetricsRegistry& registry, const std::string& loop_name);
+
+  /**
+   * @brief Create frame series of loop, which runs tasks by frames.
+   *
+   * @param registry Registry to create series in.
+   * @param loop_name Value of "loop" label.
+   */
+  void AddFrameSeries(MetricsRegistry& registry, const std::string& loop_name);
+
+  /**
+   * @brief Record tasks run by loop thread.
+   *
+   * @param run_count Tasks just run.
+   * @param ready_count Ready tasks waiting in loop.
+   */
+  void TasksRun(std::size_t run_count, std::size_t ready_count) {
+    if (tasks_run_ != nullptr && run_count != 0) {
+      tasks_run_->Increment(run_count);
+      ready_tasks_->Set(static_cast<std::int64_t>(ready_count));
+    }
+  }
+
+  /**
+   * @brief Record finished frame. Tasks run by frame are recorded by
+   * TasksRun().
+   *
+   * @param stats Frame stats.
+   */
+  void FrameRun(const FrameStats& stats) {
+    if (frame_tasks_time_ != nullptr) {
+      frame_tasks_time_->Record(ToMicroseconds(stats.tasks_time));
+      frame_backend_time_->Record(ToMicroseconds(stats.backend_time));
+      deferred_tasks_->Set(
+          static_cast<std::int64_t>(stats.deferred_tasks_count));
+    }
+  }
+
+ private:
+  static std::uint64_t ToMicroseconds(IntervalNs interval) {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(interval)
+            .count());
+  }
+
+  Counter* tasks_run_;
+  Gauge* ready_tasks_;
+  Histogram* frame_tasks_time_;
+  Histogram* frame_backend_time_;
+  Gauge* deferred_tasks_;
+};
+}  // namespace mk
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+namespace mk {
+/**
+ * @brief Task quality of service. Lower value runs first.
+ *
+ */
+enum class TaskPriority {
+  kUserBlocking,  ///< User waits for result right now.
+  kUserVisible,   ///< Result is visible to user but doesn't block him.
+  kBackground,    ///< Speculative or maintenance work.
+};
+
+constexpr std::size_t kTaskPrioritiesCount = 3;
+
+constexpr std::size_t ToIndex(TaskPriority priority) {
+  return static_cast<std::size_t>(priority);
+}
+}  // namespace mk
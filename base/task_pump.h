@@ -27,7 +27,7 @@ class TaskPump {
    *
    * @param time Wait for time.
    */
-  virtual void WaitUntil(TimestampMs time) = 0;
+  virtual void WaitUntil(TimestampNs time) = 0;
 
   /**
    * @brief Notify changes.
@@ -0,0 +1,196 @@
+#include "task_pump_epoll.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+
+namespace mk {
+namespace {
+constexpr int kMaxEventsCount = 64;
+
+int CheckResult(int result, const char* what) {
+  if (result < 0) {
+    throw std::system_error{errno, std::generic_category(), what};
+  }
+
+  return result;
+}
+
+std::uint32_t ToEpollEvents(unsigned events) {
+  std::uint32_t epoll_events = 0;
+  if (events & TaskPumpEpoll::kReadable) {
+    epoll_events |= EPOLLIN;
+  }
+  if (events & TaskPumpEpoll::kWritable) {
+    epoll_events |= EPOLLOUT;
+  }
+
+  return epoll_events;
+}
+
+unsigned FromEpollEvents(std::uint32_t epoll_events) {
+  unsigned events = 0;
+  if (epoll_events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+    events |= TaskPumpEpoll::kReadable;
+  }
+  if (epoll_events & EPOLLOUT) {
+    events |= TaskPumpEpoll::kWritable;
+  }
+
+  return events;
+}
+}  // namespace
+
+TaskPumpEpoll::TaskPumpEpoll()
+    : epoll_fd_{CheckResult(epoll_create1(EPOLL_CLOEXEC), "epoll_create1")},
+      event_fd_{CheckResult(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+                            "eventfd")},
+      timer_fd_{CheckResult(
+          timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC),
+          "timerfd_create")},
+      armed_time_{TimestampNs::max()},
+      state_{State::kAwake},
+      watcher_thread_{std::thread::id{}} {
+  for (const auto fd : {event_fd_, timer_fd_}) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    CheckResult(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event), "epoll_ctl");
+  }
+}
+
+TaskPumpEpoll::~TaskPumpEpoll() {
+  close(timer_fd_);
+  close(event_fd_);
+  close(epoll_fd_);
+}
+
+void TaskPumpEpoll::Run(std::shared_ptr<DispatchTask>) {}
+
+void TaskPumpEpoll::WaitUntil(TimestampNs time) {
+  auto timeout = -1;
+
+  auto expected = State::kAwake;
+  if (!state_.compare_exchange_strong(expected, State::kSleeping)) {
+    // Tasks were posted while loop was awake. Only poll watchers.
+    state_ = State::kAwake;
+    timeout = 0;
+  } else {
+    ArmTimer(time);
+  }
+
+  std::array<epoll_event, kMaxEventsCount> events;
+  const auto count =
+      epoll_wait(epoll_fd_, events.data(), kMaxEventsCount, timeout);
+
+  state_ = State::kAwake;
+
+  for (auto i = 0; i < count; ++i) {
+    const auto& event = events[static_cast<std::size_t>(i)];
+
+    if (event.data.fd == event_fd_) {
+      Drain(event_fd_);
+    } else if (event.data.fd == timer_fd_) {
+      Drain(timer_fd_);
+      armed_time_ = TimestampNs::max();
+    } else {
+      RunWatcher(event.data.fd, FromEpollEvents(event.events));
+    }
+  }
+}
+
+void TaskPumpEpoll::Notify() {
+  if (state_.exchange(State::kNotified) != State::kSleeping) {
+    // Loop is awake and checks tasks before it sleeps.
+    return;
+  }
+
+  const std::uint64_t value = 1;
+  [[maybe_unused]] const auto result =
+      write(event_fd_, &value, sizeof(value));
+}
+
+std::error_code TaskPumpEpoll::WatchFileDescriptor(
+    int fd, unsigned events, FileDescriptorCallback callback) {
+  std::lock_guard lock{watchers_guard_};
+
+  epoll_event event{};
+  event.events = ToEpollEvents(events);
+  event.data.fd = fd;
+
+  const auto operation =
+      watchers_.count(fd) != 0 ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (epoll_ctl(epoll_fd_, operation, fd, &event) < 0) {
+    return std::error_code{errno, std::generic_category()};
+  }
+
+  watchers_[fd] = std::move(callback);
+  return {};
+}
+
+void TaskPumpEpoll::UnwatchFileDescriptor(int fd) {
+  {
+    std::lock_guard lock{watchers_guard_};
+    if (watchers_.erase(fd) == 0) {
+      return;
+    }
+
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  }
+
+  // Callback may be unwatched by itself.
+  if (watcher_thread_.load() != std::this_thread::get_id()) {
+    std::lock_guard run_lock{watcher_run_guard_};
+  }
+}
+
+void TaskPumpEpoll::ArmTimer(TimestampNs time) {
+  if (time == armed_time_) {
+    return;
+  }
+
+  // Zero value disarms timer.
+  itimerspec spec{};
+  if (time != TimestampNs::max()) {
+    const auto count = std::max<TimestampNs::rep>(time.count(), 1);
+    spec.it_value.tv_sec = static_cast<time_t>(count / 1000000000);
+    spec.it_value.tv_nsec = static_cast<long>(count % 1000000000);
+  }
+
+  // Steady clock is CLOCK_MONOTONIC.
+  timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+  armed_time_ = time;
+}
+
+void TaskPumpEpoll::Drain(int fd) {
+  std::uint64_t value = 0;
+  [[maybe_unused]] const auto result = read(fd, &value, sizeof(value));
+}
+
+void TaskPumpEpoll::RunWatcher(int fd, unsigned events) {
+  // Unwatching thread waits for callback found here.
+  std::lock_guard run_lock{watcher_run_guard_};
+
+  FileDescriptorCallback callback;
+  {
+    std::lock_guard lock{watchers_guard_};
+    const auto it = watchers_.find(fd);
+    if (it == watchers_.end()) {
+      // Unwatched by previous callback.
+      return;
+    }
+
+    callback = it->second;
+  }
+
+  watcher_thread_ = std::this_thread::get_id();
+  callback(fd, events);
+  watcher_thread_ = std::thread::id{};
+}
+}  // namespace mk
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+#include "task_pump.h"
+
+namespace mk {
+/**
+ * @brief Controls message pumping by Linux epoll.
+ *
+ * Loop sleeps in epoll_wait. Notify() writes to eventfd only if loop sleeps,
+ * so posting to awake loop costs one atomic exchange. Wait deadline is set
+ * by timerfd. File descriptors can be watched, their callbacks are called on
+ * loop thread while it waits for tasks.
+ *
+ */
+class TaskPumpEpoll : public TaskPump {
+ public:
+  /**
+   * @brief File descriptor readiness. Error and hang up are reported as
+   * kReadable, so next read reports them.
+   *
+   */
+  enum FileDescriptorEvents : unsigned {
+    kReadable = 1u << 0,
+    kWritable = 1u << 1,
+  };
+
+  using FileDescriptorCallback = std::function<void(int fd, unsigned events)>;
+
+  TaskPumpEpoll();
+  ~TaskPumpEpoll() override;
+
+  TaskPumpEpoll(const TaskPumpEpoll&) = delete;
+  TaskPumpEpoll& operator=(const TaskPumpEpoll&) = delete;
+
+  /** @see TaskPump. */
+  void Run(std::shared_ptr<DispatchTask> task_dispatcher) override;
+
+  /** @see TaskPump. */
+  void WaitUntil(TimestampNs time) override;
+
+  /** @see TaskPump. */
+  void Notify() override;
+
+  /**
+   * @brief Call callback on loop thread whenever file descriptor is ready.
+   *
+   * Watch is level triggered. May be called from any thread.
+   *
+   * @param fd File descriptor. Only one watch per descriptor.
+   * @param events FileDescriptorEvents mask.
+   * @param callback Callback.
+   * @return Error code of epoll_ctl.
+   */
+  std::error_code WatchFileDescriptor(int fd, unsigned events,
+                                      FileDescriptorCallback callback);
+
+  /**
+   * @brief Stop watching file descriptor. Must be called before fd is
+   * closed. May be called from any thread. If callback is running on another
+   * thread, waits until it returns, so callback isn't called after.
+   *
+   * @param fd Watched file descriptor.
+   */
+  void UnwatchFileDescriptor(int fd);
+
+ private:
+  /**
+   * @brief Loop state used to elide wakeups.
+   *
+   */
+  enum class State {
+    kAwake,     ///< Loop runs tasks.
+    kSleeping,  ///< Loop is in epoll_wait or about to enter it.
+    kNotified,  ///< Tasks were posted while loop was awake.
+  };
+
+  void ArmTimer(TimestampNs time);
+  void Drain(int fd);
+  void RunWatcher(int fd, unsigned events);
+
+  int epoll_fd_;
+  int event_fd_;
+  int timer_fd_;
+  TimestampNs armed_time_;
+
+  std::atomic<State> state_;
+
+  std::mutex watchers_guard_;
+  std::unordered_map<int, FileDescriptorCallback> watchers_;
+
+  /// Held while watcher callback runs.
+  std::mutex watcher_run_guard_;
+  std::atomic<std::thread::id> watcher_thread_;
+};
+}  // namespace mk
@@ -3,22 +3,35 @@
 namespace mk {
 void TaskPumpStd::Run(std::shared_ptr<DispatchTask>) {}
 
-void TaskPumpStd::WaitUntil(TimestampMs time) {
-  if (std::unique_lock lock{guard_}; time == TimestampMs::max()) {
-    Wait(lock);
-  } else {
-    WaitUntilTime(lock, time);
+void TaskPumpStd::WaitUntil(TimestampNs time) {
+  std::unique_lock lock{guard_};
+
+  if (!is_notified_) {
+    if (time == TimestampNs::max()) {
+      Wait(lock);
+    } else {
+      WaitUntilTime(lock, time);
+    }
   }
+
+  is_notified_ = false;
 }
 
-void TaskPumpStd::Notify() { NotifyAll(); }
+void TaskPumpStd::Notify() {
+  if (is_notified_.exchange(true)) {
+    return;
+  }
+
+  std::lock_guard lock{guard_};
+  NotifyAll();
+}
 
 void TaskPumpStd::Wait(std::unique_lock<std::mutex>& lock) {
   event_.wait(lock);
 }
 
 void TaskPumpStd::WaitUntilTime(std::unique_lock<std::mutex>& lock,
-                            TimestampMs time) {
+                            TimestampNs time) {
   event_.wait_until(lock, std::chrono::steady_clock::time_point{time});
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 
 #include "task_pump.h"
@@ -9,6 +10,10 @@ namespace mk {
 /**
  * @brief Controls message pumping by c++ std.
  *
+ * Notification is remembered until next wait, so Notify() called while pump
+ * is not waiting is not lost. Repeated notifications before next wait don't
+ * touch mutex and condition variable.
+ *
  */
 class TaskPumpStd : public TaskPump {
  public:
@@ -16,18 +21,19 @@ class TaskPumpStd : public TaskPump {
   void Run(std::shared_ptr<DispatchTask> task_dispatcher) override;
 
   /** @see TaskPump. */
-  void WaitUntil(TimestampMs time) override;
+  void WaitUntil(TimestampNs time) override;
 
   /** @see TaskPump. */
   void Notify() override;
 
  protected:  // for tests
   virtual void Wait(std::unique_lock<std::mutex>& lock);
-  virtual void WaitUntilTime(std::unique_lock<std::mutex>& lock, TimestampMs time);
+  virtual void WaitUntilTime(std::unique_lock<std::mutex>& lock, TimestampNs time);
   virtual void NotifyAll();
 
  private:
   std::condition_variable event_;
   std::mutex guard_;
+  std::atomic<bool> is_notified_{false};
 };
 }  // namespace mk
\ No newline at end of file
@@ -0,0 +1,14 @@
+#include "task_pump_virtual.h"
+
+#include "virtual_time_provider.h"
+
+namespace mk {
+TaskPumpVirtual::TaskPumpVirtual(
+    std::shared_ptr<VirtualTimeProvider> time_provider)
+    : time_provider_{std::move(time_provider)} {}
+
+void TaskPumpVirtual::WaitUntilTime(std::unique_lock<std::mutex>&,
+                                    TimestampNs time) {
+  time_provider_->AdvanceTo(time);
+}
+}  // namespace mk
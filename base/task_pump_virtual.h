@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+
+#include "task_pump_std.h"
+
+namespace mk {
+class VirtualTimeProvider;
+
+/**
+ * @brief Controls message pumping in virtual time.
+ *
+ * Instead of sleeping until next task call time pump advances virtual time
+ * to it, so idle loop runs next delayed task at once. Loop without delayed
+ * tasks waits for Notify() like TaskPumpStd does. Loop must use the same
+ * VirtualTimeProvider.
+ *
+ */
+class TaskPumpVirtual : public TaskPumpStd {
+ public:
+  explicit TaskPumpVirtual(std::shared_ptr<VirtualTimeProvider> time_provider);
+
+ protected:
+  /** @see TaskPumpStd. */
+  void WaitUntilTime(std::unique_lock<std::mutex>& lock,
+                     TimestampNs time) override;
+
+ private:
+  std::shared_ptr<VirtualTimeProvider> time_provider_;
+};
+}  // namespace mk
@@ -1,9 +1,6 @@
 #pragma once
 
-#include <memory>
-
 #include "pending_task.h"
-#include "task_handle.h"
 
 namespace mk {
 /**
@@ -15,18 +12,28 @@ class TaskQueue {
   virtual ~TaskQueue() = default;
 
   /**
-   * @brief Add task to queue.
+   * @brief Add task to queue. Queue doesn't own task.
+   *
+   * Queue keeps task position in PendingTask::queue_index until task is
+   * popped or removed.
    *
    * @param task Task to be added.
    */
-  virtual TaskHandle AddTask(std::shared_ptr<PendingTask> task) = 0;
+  virtual void AddTask(PendingTask* task) = 0;
 
   /**
    * @brief Pop task from queue.
    *
    * @return Task or nullptr.
    */
-  virtual std::shared_ptr<PendingTask> PopTask() = 0;
+  virtual PendingTask* PopTask() = 0;
+
+  /**
+   * @brief Remove task from queue.
+   *
+   * @param task Task added to queue and not popped yet.
+   */
+  virtual void RemoveTask(PendingTask* task) = 0;
 
   /**
    * @brief Tell if queue is empty.
@@ -40,6 +47,6 @@ class TaskQueue {
    *
    * @return Task call timestamp.
    */
-  virtual TimestampMs GetNextTaskCallTime() const = 0;
+  virtual TimestampNs GetNextTaskCallTime() const = 0;
 };
 }  // namespace mk
\ No newline at end of file
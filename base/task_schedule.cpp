@@ -0,0 +1,35 @@
+#include "task_schedule.h"
+
+namespace mk {
+TimestampNs CoalesceCallTime(TimestampNs call_time, IntervalNs slack) {
+  if (slack <= IntervalNs{0} || call_time == TimestampNs::max()) {
+    return call_time;
+  }
+
+  auto grid = IntervalNs::rep{1};
+  while (grid <= slack.count() / 2) {
+    grid *= 2;
+  }
+
+  const auto count = call_time.count();
+  const auto remainder = count % grid;
+
+  return remainder == 0 ? call_time : TimestampNs{count - remainder + grid};
+}
+
+void ScheduleNextCall(PendingTask& task, TimestampNs now) {
+  if (task.repeat_mode == RepeatMode::kFixedDelay) {
+    task.planned_call = now + task.period;
+  } else {
+    task.planned_call += task.period;
+
+    if (task.period > IntervalNs{0} && task.planned_call < now) {
+      // Skip runs missed while task or loop was busy, keep the phase.
+      const auto missed_count = (now - task.planned_call) / task.period;
+      task.planned_call += missed_count * task.period;
+    }
+  }
+
+  task.next_call = CoalesceCallTime(task.planned_call, task.slack);
+}
+}  // namespace mk
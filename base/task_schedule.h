@@ -0,0 +1,26 @@
+#pragma once
+
+#include "pending_task.h"
+
+namespace mk {
+/**
+ * @brief Delay call time up to slack to align it with other timers.
+ *
+ * Call time is rounded up to multiple of the largest power of two not above
+ * slack. Timers due within the same grid cell fire at once, and grids of
+ * different slacks share their coarser points.
+ *
+ * @param call_time Planned call time.
+ * @param slack Allowed delay.
+ * @return Aligned call time.
+ */
+TimestampNs CoalesceCallTime(TimestampNs call_time, IntervalNs slack);
+
+/**
+ * @brief Set call time of task run by repeat mode and slack.
+ *
+ * @param task Task which has just run and repeats.
+ * @param now Time run has finished at.
+ */
+void ScheduleNextCall(PendingTask& task, TimestampNs now);
+}  // namespace mk
@@ -0,0 +1,191 @@
+#include "task_watchdog.h"
+
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+namespace mk {
+namespace {
+TimestampNs Now() {
+  return std::chrono::duration_cast<TimestampNs>(
+      std::chrono::steady_clock::now().time_since_epoch());
+}
+
+std::size_t GetBucket(IntervalNs duration, IntervalNs threshold) {
+  std::size_t bucket = 0;
+  for (auto limit = threshold * 2;
+       duration >= limit && bucket + 1 < kLongTaskBucketsCount; limit *= 2) {
+    ++bucket;
+  }
+
+  return bucket;
+}
+}  // namespace
+
+TaskHeartbeat::TaskHeartbeat(std::string loop_name, IntervalNs threshold)
+    : loop_name_{std::move(loop_name)},
+      threshold_{threshold},
+      sequence_{0},
+      file_{nullptr},
+      line_{0},
+      start_time_{TimestampNs{0}},
+      start_{0},
+      histogram_{},
+      reported_sequence_{0} {}
+
+void TaskHeartbeat::TaskStarted(const Location& location) {
+  location_ = location;
+  start_ = Now();
+
+  const auto sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+
+  // Reader seeing any new field value sees odd sequence as well.
+  file_.store(location.file, std::memory_order_release);
+  line_.store(location.line, std::memory_order_release);
+  start_time_.store(start_, std::memory_order_release);
+
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void TaskHeartbeat::TaskFinished() {
+  start_time_.store(TimestampNs{0}, std::memory_order_release);
+
+  const auto duration = Now() - start_;
+  if (duration < threshold_) {
+    return;
+  }
+
+  histogram_[GetBucket(duration, threshold_)].fetch_add(
+      1, std::memory_order_relaxed);
+
+  std::lock_guard lock{finished_guard_};
+  finished_tasks_.push_back(LongTask{loop_name_, location_, duration, true});
+}
+
+bool TaskHeartbeat::ReadRunningTask(std::uint64_t& sequence,
+                                    Location& location,
+                                    TimestampNs& start_time) const {
+  sequence = sequence_.load(std::memory_order_acquire);
+  if (sequence % 2 != 0) {
+    return false;
+  }
+
+  start_time = start_time_.load(std::memory_order_acquire);
+  location.file = file_.load(std::memory_order_acquire);
+  location.line = line_.load(std::memory_order_acquire);
+
+  return start_time != TimestampNs{0} &&
+         sequence_.load(std::memory_order_relaxed) == sequence;
+}
+
+TaskWatchdog::TaskWatchdog(TaskWatchdogOptions options)
+    : options_{options},
+      is_stopping_{false},
+      thread_{ThreadOptions{"watchdog"}, [this]() { Run(); }} {}
+
+TaskWatchdog::~TaskWatchdog() {
+  {
+    std::lock_guard lock{guard_};
+    is_stopping_ = true;
+    stop_event_.notify_all();
+  }
+
+  thread_.Join();
+}
+
+std::shared_ptr<TaskHeartbeat> TaskWatchdog::AddLoopThread(
+    std::string loop_name) {
+  auto heartbeat = std::make_shared<TaskHeartbeat>(std::move(loop_name),
+                                                   options_.threshold);
+
+  std::lock_guard lock{guard_};
+  heartbeats_.push_back(heartbeat);
+
+  return heartbeat;
+}
+
+void TaskWatchdog::SetLongTaskCallback(LongTaskCallback callback) {
+  std::lock_guard lock{guard_};
+  callback_ = std::move(callback);
+}
+
+std::map<std::string, LongTaskHistogram> TaskWatchdog::GetHistograms() const {
+  std::map<std::string, LongTaskHistogram> histograms;
+
+  std::lock_guard lock{guard_};
+  for (const auto& heartbeat : heartbeats_) {
+    auto& histogram = histograms[heartbeat->loop_name_];
+    for (std::size_t i = 0; i < kLongTaskBucketsCount; ++i) {
+      histogram[i] += heartbeat->histogram_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  return histograms;
+}
+
+void TaskWatchdog::Run() {
+  std::unique_lock lock{guard_};
+  while (!is_stopping_) {
+    stop_event_.wait_for(lock, options_.check_period);
+
+    lock.unlock();
+    Check();
+    lock.lock();
+  }
+}
+
+void TaskWatchdog::Check() {
+  std::vector<std::shared_ptr<TaskHeartbeat>> heartbeats;
+  {
+    std::lock_guard lock{guard_};
+    heartbeats = heartbeats_;
+  }
+
+  const auto now = Now();
+  for (const auto& heartbeat : heartbeats) {
+    std::uint64_t sequence = 0;
+    Location location;
+    auto start_time = TimestampNs{0};
+
+    if (heartbeat->ReadRunningTask(sequence, location, start_time) &&
+        now - start_time >= options_.threshold &&
+        sequence != heartbeat->reported_sequence_) {
+      // Report wedged task once while it runs.
+      heartbeat->reported_sequence_ = sequence;
+      Report(
+          LongTask{heartbeat->loop_name_, location, now - start_time, false});
+    }
+
+    std::vector<LongTask> finished_tasks;
+    {
+      std::lock_guard lock{heartbeat->finished_guard_};
+      finished_tasks.swap(heartbeat->finished_tasks_);
+    }
+
+    for (const auto& task : finished_tasks) {
+      Report(task);
+    }
+  }
+}
+
+void TaskWatchdog::Report(const LongTask& task) {
+  LongTaskCallback callback;
+  {
+    std::lock_guard lock{guard_};
+    callback = callback_;
+  }
+
+  if (callback) {
+    callback(task);
+    return;
+  }
+
+  std::cerr << "Long task on " << task.loop_name << " loop posted from "
+            << (task.location.file ? task.location.file : "unknown") << ":"
+            << task.location.line
+            << (task.is_finished ? " took " : " is running for ")
+            << std::chrono::duration_cast<IntervalMs>(task.duration).count()
+            << " ms" << std::endl;
+}
+}  // namespace mk
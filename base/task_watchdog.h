@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "location.h"
+#include "thread.h"
+#include "time_types.h"
+
+namespace mk {
+/**
+ * @brief Task watchdog configuration.
+ *
+ */
+struct TaskWatchdogOptions {
+  /// Tasks running longer are reported.
+  IntervalNs threshold{IntervalMs{200}};
+
+  /// How often watchdog looks for tasks running over threshold.
+  IntervalNs check_period{IntervalMs{50}};
+};
+
+/**
+ * @brief Over-budget task.
+ *
+ */
+struct LongTask {
+  std::string loop_name;
+  Location location;    ///< Task posting location.
+  IntervalNs duration;  ///< Time spent so far or in total if finished.
+  bool is_finished;
+};
+
+/// Over-budget tasks counts. Bucket N counts tasks which took less than
+/// threshold * 2^(N+1), last bucket counts the rest.
+constexpr std::size_t kLongTaskBucketsCount = 6;
+using LongTaskHistogram = std::array<std::size_t, kLongTaskBucketsCount>;
+
+/**
+ * @brief Heartbeats of one loop thread.
+ *
+ * Loop thread calls TaskStarted() and TaskFinished() around every task.
+ * Running task is published without locks, watchdog thread reads it.
+ *
+ */
+class TaskHeartbeat {
+ public:
+  TaskHeartbeat(std::string loop_name, IntervalNs threshold);
+
+  TaskHeartbeat(const TaskHeartbeat&) = delete;
+  TaskHeartbeat& operator=(const TaskHeartbeat&) = delete;
+
+  /**
+   * @brief Publish task start. Must be called by loop thread.
+   *
+   * @param location Task posting location.
+   */
+  void TaskStarted(const Location& location);
+
+  /**
+   * @brief Publish task finish. Must be called by loop thread.
+   *
+   */
+  void TaskFinished();
+
+ private:
+  friend class TaskWatchdog;
+
+  /**
+   * @brief Read running task. May be called from any thread.
+   *
+   * @return false if no task runs or task has changed while reading.
+   */
+  bool ReadRunningTask(std::uint64_t& sequence, Location& location,
+                       TimestampNs& start_time) const;
+
+  const std::string loop_name_;
+  const IntervalNs threshold_;
+
+  /// Odd while task location is written.
+  std::atomic<std::uint64_t> sequence_;
+  std::atomic<const char*> file_;
+  std::atomic<int> line_;
+  /// Zero if loop doesn't run task.
+  std::atomic<TimestampNs> start_time_;
+
+  // Loop thread only.
+  Location location_;
+  TimestampNs start_;
+
+  std::array<std::atomic<std::size_t>, kLongTaskBucketsCount> histogram_;
+
+  std::mutex finished_guard_;
+  std::vector<LongTask> finished_tasks_;
+
+  // Watchdog thread only.
+  std::uint64_t reported_sequence_;
+};
+
+/**
+ * @brief Reports tasks which run too long, e.g. jank on UI thread or wedged
+ * decode on filesystem thread.
+ *
+ * Watchdog thread reports task still running over threshold once, and loop
+ * thread queues report of every over-budget task when it finishes. Reports
+ * go to std::cerr unless callback is set.
+ *
+ */
+class TaskWatchdog {
+ public:
+  using LongTaskCallback = std::function<void(const LongTask& task)>;
+
+  explicit TaskWatchdog(TaskWatchdogOptions options);
+  ~TaskWatchdog();
+
+  TaskWatchdog(const TaskWatchdog&) = delete;
+  TaskWatchdog& operator=(const TaskWatchdog&) = delete;
+
+  /**
+   * @brief Create heartbeat for loop thread.
+   *
+   * Threads of one loop share the name and histogram.
+   *
+   * @param loop_name Loop name used in reports.
+   * @return Heartbeat.
+   */
+  std::shared_ptr<TaskHeartbeat> AddLoopThread(std::string loop_name);
+
+  /**
+   * @brief Replace default std::cerr reporting. Callback is called on
+   * watchdog thread.
+   *
+   * @param callback Report callback.
+   */
+  void SetLongTaskCallback(LongTaskCallback callback);
+
+  /**
+   * @brief Get over-budget tasks histogram of every loop.
+   *
+   */
+  std::map<std::string, LongTaskHistogram> GetHistograms() const;
+
+ private:
+  void Run();
+  void Check();
+  void Report(const LongTask& task);
+
+  const TaskWatchdogOptions options_;
+
+  mutable std::mutex guard_;
+  std::condition_variable stop_event_;
+  std::vector<std::shared_ptr<TaskHeartbeat>> heartbeats_;
+  LongTaskCallback callback_;
+  bool is_stopping_;
+
+  Thread thread_;
+};
+
+/**
+ * @brief Heartbeat around task run. Does nothing without heartbeat.
+ *
+ */
+class ScopedTaskHeartbeat {
+ public:
+  ScopedTaskHeartbeat(TaskHeartbeat* heartbeat, const Location& location)
+      : heartbeat_{heartbeat} {
+    if (heartbeat_) {
+      heartbeat_->TaskStarted(location);
+    }
+  }
+
+  ~ScopedTaskHeartbeat() {
+    if (heartbeat_) {
+      heartbeat_->TaskFinished();
+    }
+  }
+
+  ScopedTaskHeartbeat(const ScopedTaskHeartbeat&) = delete;
+  ScopedTaskHeartbeat& operator=(const ScopedTaskHeartbeat&) = delete;
+
+ private:
+  TaskHeartbeat* heartbeat_;
+};
+}  // namespace mk
@@ -0,0 +1,143 @@
+// Pending task slots are reused, and handles of released or foreign tasks
+// are never found. Loop ignores stale handle of reused slot.
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "pending_task_pool.h"
+#include "priority_task_queue.h"
+#include "run_loop.h"
+#include "task_pump_virtual.h"
+#include "test_check.h"
+#include "virtual_time_provider.h"
+
+namespace mk {
+namespace {
+PendingTask* AcquireTask(PendingTaskPool& pool, Task task = Task{[]() {}}) {
+  return pool.Acquire(std::move(task), 1, IntervalNs{0}, TimestampNs{0},
+                      TaskPriority::kUserVisible);
+}
+
+void TestReleasedHandleIsStale() {
+  PendingTaskPool pool;
+
+  auto* first_task = AcquireTask(pool);
+  const TaskHandle first_handle{*first_task};
+  MK_CHECK(first_handle.IsIssued());
+  MK_CHECK(pool.Find(first_handle) == first_task);
+
+  // Released task state is destroyed at once.
+  auto state = std::make_shared<int>(0);
+  auto* second_task = AcquireTask(pool, Task{[state]() {}});
+  MK_CHECK(state.use_count() == 2);
+  pool.Release(second_task);
+  MK_CHECK(state.use_count() == 1);
+
+  pool.Release(first_task);
+  MK_CHECK(pool.Find(first_handle) == nullptr);
+
+  // Slot is reused by the next task with new generation.
+  auto* reused_task = AcquireTask(pool);
+  MK_CHECK(reused_task == first_task || reused_task == second_task);
+  MK_CHECK(pool.Find(first_handle) == nullptr);
+  MK_CHECK(pool.Find(TaskHandle{*reused_task}) == reused_task);
+}
+
+void TestForeignHandleIsNotFound() {
+  PendingTaskPool pool;
+  PendingTaskPool other_pool;
+
+  auto* task = AcquireTask(pool);
+  auto* other_task = AcquireTask(other_pool);
+  MK_CHECK(task->slot == other_task->slot);
+
+  MK_CHECK(pool.Find(TaskHandle{*other_task}) == nullptr);
+  MK_CHECK(pool.Find(TaskHandle{}) == nullptr);
+  MK_CHECK(pool.Find(TaskHandle::FromId(task->owner, 1)) == nullptr);
+  MK_CHECK(!TaskHandle{}.IsIssued());
+}
+
+void TestTasksKeepAddressWhilePoolGrows() {
+  PendingTaskPool pool;
+
+  std::vector<PendingTask*> tasks;
+  std::vector<TaskHandle> handles;
+  for (int i = 0; i < 5000; ++i) {
+    tasks.push_back(AcquireTask(pool));
+    handles.emplace_back(*tasks.back());
+  }
+
+  MK_CHECK(std::set<PendingTask*>(tasks.begin(), tasks.end()).size() ==
+           tasks.size());
+  for (std::size_t i = 0; i < tasks.size(); ++i) {
+    MK_CHECK(pool.Find(handles[i]) == tasks[i]);
+  }
+}
+
+void TestConcurrentAcquireAndRelease() {
+  PendingTaskPool pool;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&pool]() {
+      std::vector<PendingTask*> tasks;
+      for (int round = 0; round < 200; ++round) {
+        for (int j = 0; j < 100; ++j) {
+          tasks.push_back(AcquireTask(pool));
+        }
+        for (auto* task : tasks) {
+          pool.Release(task);
+        }
+        tasks.clear();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Every slot is free again and handed out once.
+  std::set<PendingTask*> tasks;
+  for (int i = 0; i < 400; ++i) {
+    MK_CHECK(tasks.insert(AcquireTask(pool)).second);
+  }
+}
+
+void TestLoopIgnoresStaleHandle() {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  RunLoop loop{std::make_unique<TaskPumpVirtual>(time),
+               std::make_unique<PriorityTaskQueue>(), time};
+
+  // Third task reuses slot of the first one, which is done by then.
+  int runs_count = 0;
+  TaskHandle first_handle;
+  first_handle = loop.PostTask([&]() {
+    ++runs_count;
+    loop.PostTask([&]() {
+      const auto third_handle = loop.PostTask([&]() { ++runs_count; });
+      MK_CHECK(third_handle.slot == first_handle.slot);
+      loop.CancelTask(std::move(first_handle));
+    });
+  });
+
+  loop.PostDelayedTask([&]() { loop.Stop(); }, std::chrono::seconds{1});
+  loop.Run();
+
+  MK_CHECK(runs_count == 2);
+}
+}  // namespace
+}  // namespace mk
+
+int main() {
+  mk::TestReleasedHandleIsStale();
+  mk::TestForeignHandleIsNotFound();
+  mk::TestTasksKeepAddressWhilePoolGrows();
+  mk::TestConcurrentAcquireAndRelease();
+  mk::TestLoopIgnoresStaleHandle();
+
+  return 0;
+}
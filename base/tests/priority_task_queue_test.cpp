@@ -0,0 +1,120 @@
+// Removed tasks leave heap at once, the rest still pops in call time order.
+// Cancelled delayed task of a loop is removed from its queue, so its state
+// doesn't wait for its call time.
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "priority_task_queue.h"
+#include "run_loop.h"
+#include "task_pump_virtual.h"
+#include "test_check.h"
+#include "thread_pool_run_loop.h"
+#include "virtual_time_provider.h"
+
+namespace mk {
+namespace {
+std::vector<std::unique_ptr<PendingTask>> MakeTasks(std::size_t count) {
+  std::mt19937_64 random{7};
+
+  std::vector<std::unique_ptr<PendingTask>> tasks;
+  for (std::size_t i = 0; i < count; ++i) {
+    // Few distinct call times, so equal ones meet in heap too.
+    const auto call_time = TimestampNs{
+        static_cast<TimestampNs::rep>(random() % (count / 4 + 1))};
+    tasks.push_back(std::make_unique<PendingTask>(Task{[]() {}}, call_time));
+  }
+
+  return tasks;
+}
+
+void CheckPopsInOrder(TaskQueue& queue, std::size_t expected_count) {
+  std::vector<TimestampNs> call_times;
+  while (!queue.IsEmpty()) {
+    const auto call_time = queue.GetNextTaskCallTime();
+    auto* task = queue.PopTask();
+    MK_CHECK(task->next_call == call_time);
+    MK_CHECK(task->queue_index == PendingTask::kNotQueued);
+    call_times.push_back(call_time);
+  }
+
+  MK_CHECK(call_times.size() == expected_count);
+  MK_CHECK(std::is_sorted(call_times.begin(), call_times.end()));
+}
+
+void TestRemoveFromEveryPosition() {
+  // Every heap position of every small heap size, so sifting both up and
+  // down after removal is covered.
+  for (std::size_t size = 1; size <= 40; ++size) {
+    for (std::size_t removed = 0; removed < size; ++removed) {
+      auto tasks = MakeTasks(size);
+      PriorityTaskQueue queue;
+      for (auto& task : tasks) {
+        queue.AddTask(task.get());
+      }
+
+      queue.RemoveTask(tasks[removed].get());
+      MK_CHECK(tasks[removed]->queue_index == PendingTask::kNotQueued);
+      CheckPopsInOrder(queue, size - 1);
+    }
+  }
+}
+
+void TestRemoveManyTasks() {
+  auto tasks = MakeTasks(10000);
+  PriorityTaskQueue queue;
+  for (auto& task : tasks) {
+    queue.AddTask(task.get());
+  }
+
+  // Random tasks, then some top ones.
+  std::mt19937_64 random{11};
+  std::size_t removed_count = 0;
+  for (auto& task : tasks) {
+    if (random() % 2 == 0) {
+      queue.RemoveTask(task.get());
+      ++removed_count;
+    }
+  }
+  while (removed_count < 6000 && !queue.IsEmpty()) {
+    queue.PopTask();
+    ++removed_count;
+  }
+
+  CheckPopsInOrder(queue, tasks.size() - removed_count);
+}
+
+template <typename Loop>
+void CheckCancelledStateIsDestroyed(Loop& loop) {
+  auto state = std::make_shared<int>(0);
+  auto handle = loop.PostDelayedTask([state]() {}, std::chrono::hours{1});
+  MK_CHECK(state.use_count() == 2);
+
+  loop.CancelTask(std::move(handle));
+  MK_CHECK(state.use_count() == 1);
+}
+
+void TestCancelledDelayedTaskIsRemoved() {
+  auto time = std::make_shared<VirtualTimeProvider>();
+
+  RunLoop loop{std::make_unique<TaskPumpVirtual>(time),
+               std::make_unique<PriorityTaskQueue>(), time};
+  CheckCancelledStateIsDestroyed(loop);
+
+  ThreadPoolRunLoop pool{ThreadPoolOptions{2},
+                         std::make_unique<PriorityTaskQueue>(), time};
+  CheckCancelledStateIsDestroyed(pool);
+}
+}  // namespace
+}  // namespace mk
+
+int main() {
+  mk::TestRemoveFromEveryPosition();
+  mk::TestRemoveManyTasks();
+  mk::TestCancelledDelayedTaskIsRemoved();
+
+  return 0;
+}
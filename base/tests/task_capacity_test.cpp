@@ -0,0 +1,161 @@
+// Bounded loops apply overflow policy to immediate tasks, and coalesced
+// tasks replace pending tasks of the same key.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "priority_task_queue.h"
+#include "run_loop.h"
+#include "task_pump_virtual.h"
+#include "test_check.h"
+#include "thread_pool_run_loop.h"
+#include "virtual_time_provider.h"
+
+namespace mk {
+namespace {
+std::shared_ptr<RunLoop> MakeRunLoop(std::size_t capacity,
+                                     OverflowPolicy overflow_policy) {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  return std::make_shared<RunLoop>(
+      RunLoopOptions{capacity, overflow_policy},
+      std::make_unique<TaskPumpVirtual>(time),
+      std::make_unique<PriorityTaskQueue>(), time);
+}
+
+std::shared_ptr<ThreadPoolRunLoop> MakePool(std::size_t capacity,
+                                            OverflowPolicy overflow_policy) {
+  auto time = std::make_shared<VirtualTimeProvider>();
+
+  ThreadPoolOptions options;
+  options.capacity = capacity;
+  options.overflow_policy = overflow_policy;
+  return std::make_shared<ThreadPoolRunLoop>(
+      options, std::make_unique<PriorityTaskQueue>(), time,
+      std::make_shared<TaskPumpVirtual>(time));
+}
+
+/**
+ * @brief Run loop until its delayed tasks are done.
+ *
+ * @return Runs sorted, pool owner takes own tasks newest first.
+ */
+template <typename Loop>
+std::vector<int> RunPending(Loop& loop, std::vector<int>& runs) {
+  loop.PostDelayedTask([&loop]() { loop.Stop(); }, std::chrono::seconds{1});
+  loop.Run();
+
+  std::sort(runs.begin(), runs.end());
+  return runs;
+}
+
+template <typename MakeLoop>
+void CheckReject(MakeLoop make_loop) {
+  auto loop = make_loop(2, OverflowPolicy::kReject);
+
+  std::vector<int> runs;
+  std::vector<TaskHandle> handles;
+  for (int i = 0; i < 3; ++i) {
+    handles.push_back(loop->PostTask([&runs, i]() { runs.push_back(i); }));
+  }
+
+  MK_CHECK(handles[0].IsIssued() && handles[1].IsIssued());
+  MK_CHECK(!handles[2].IsIssued());
+
+  MK_CHECK((RunPending(*loop, runs) == std::vector<int>{0, 1}));
+}
+
+template <typename MakeLoop>
+void CheckDropOldest(MakeLoop make_loop) {
+  auto loop = make_loop(2, OverflowPolicy::kDropOldest);
+
+  // Lowest priority task is dropped first, then the oldest one.
+  std::vector<int> runs;
+  loop->PostTask([&runs]() { runs.push_back(0); }, TaskPriority::kUserVisible);
+  loop->PostTask([&runs]() { runs.push_back(1); }, TaskPriority::kBackground);
+  loop->PostTask([&runs]() { runs.push_back(2); }, TaskPriority::kUserVisible);
+  loop->PostTask([&runs]() { runs.push_back(3); }, TaskPriority::kUserVisible);
+
+  MK_CHECK((RunPending(*loop, runs) == std::vector<int>{2, 3}));
+}
+
+template <typename MakeLoop>
+void CheckBlock(MakeLoop make_loop) {
+  auto loop = make_loop(2, OverflowPolicy::kBlock);
+  std::thread loop_thread{[&loop]() { loop->Run(); }};
+
+  // Busy loop holds both posted tasks, the third poster waits.
+  std::atomic<bool> is_loop_busy{false};
+  std::atomic<bool> is_loop_released{false};
+  loop->PostTask([&]() {
+    is_loop_busy = true;
+    while (!is_loop_released) {
+      std::this_thread::yield();
+    }
+  });
+  while (!is_loop_busy) {
+    std::this_thread::yield();
+  }
+
+  std::atomic<int> runs_count{0};
+  const auto run = [&]() {
+    if (++runs_count == 3) {
+      loop->Stop();
+    }
+  };
+  loop->PostTask(run);
+  loop->PostTask(run);
+
+  std::atomic<bool> is_posted{false};
+  std::thread poster{[&]() {
+    loop->PostTask(run);
+    is_posted = true;
+  }};
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  MK_CHECK(!is_posted);
+
+  is_loop_released = true;
+  poster.join();
+  loop_thread.join();
+  MK_CHECK(runs_count == 3);
+}
+
+template <typename MakeLoop>
+void CheckCoalesced(MakeLoop make_loop) {
+  auto loop = make_loop(2, OverflowPolicy::kReject);
+
+  // Replaced task never runs and keeps no capacity.
+  std::vector<int> runs;
+  auto replaced_state = std::make_shared<int>(0);
+  loop->PostCoalescedTask("key", [&runs, replaced_state]() {
+    runs.push_back(0);
+  });
+  for (int i = 1; i <= 3; ++i) {
+    MK_CHECK(loop->PostCoalescedTask("key", [&runs, i]() { runs.push_back(i); })
+                 .IsIssued());
+  }
+  MK_CHECK(replaced_state.use_count() == 1);
+  MK_CHECK(loop->PostCoalescedTask("other", [&runs]() { runs.push_back(4); })
+               .IsIssued());
+
+  MK_CHECK((RunPending(*loop, runs) == std::vector<int>{3, 4}));
+}
+}  // namespace
+}  // namespace mk
+
+int main() {
+  mk::CheckReject(mk::MakeRunLoop);
+  mk::CheckReject(mk::MakePool);
+  mk::CheckDropOldest(mk::MakeRunLoop);
+  mk::CheckDropOldest(mk::MakePool);
+  mk::CheckBlock(mk::MakeRunLoop);
+  mk::CheckBlock(mk::MakePool);
+  mk::CheckCoalesced(mk::MakeRunLoop);
+  mk::CheckCoalesced(mk::MakePool);
+
+  return 0;
+}
@@ -0,0 +1,144 @@
+// Fixed rate and fixed delay repeating tasks keep their schedules, missed
+// fixed rate runs are skipped, and timers with slack share wakeups. Loops
+// run in virtual time, so schedules are exact.
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "run_loop.h"
+#include "task_pump_virtual.h"
+#include "task_schedule.h"
+#include "test_check.h"
+#include "thread_pool_run_loop.h"
+#include "timing_wheel_task_queue.h"
+#include "virtual_time_provider.h"
+
+namespace mk {
+namespace {
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+std::shared_ptr<RunLoop> MakeRunLoop(
+    std::shared_ptr<VirtualTimeProvider> time) {
+  return std::make_shared<RunLoop>(std::make_unique<TaskPumpVirtual>(time),
+                                   std::make_unique<TimingWheelTaskQueue>(time),
+                                   time);
+}
+
+std::shared_ptr<ThreadPoolRunLoop> MakePool(
+    std::shared_ptr<VirtualTimeProvider> time) {
+  return std::make_shared<ThreadPoolRunLoop>(
+      ThreadPoolOptions{1}, std::make_unique<TimingWheelTaskQueue>(time), time,
+      std::make_shared<TaskPumpVirtual>(time));
+}
+
+/**
+ * @brief Run repeating task which works for given time on every run.
+ *
+ * @return Start times of runs.
+ */
+template <typename MakeLoop>
+std::vector<TimestampNs> RunRepeating(MakeLoop make_loop, RepeatMode mode,
+                                      std::vector<IntervalNs> work_times) {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  auto loop = make_loop(time);
+
+  std::vector<TimestampNs> start_times;
+  TimerOptions options;
+  options.repeat_mode = mode;
+  loop->PostRepeatingTask(
+      [&]() {
+        start_times.push_back(time->Now());
+        time->Advance(work_times[start_times.size() - 1]);
+      },
+      work_times.size(), milliseconds{10}, TaskPriority::kUserVisible,
+      options);
+  loop->PostDelayedTask([&]() { loop->Stop(); }, std::chrono::seconds{1});
+  loop->Run();
+
+  return start_times;
+}
+
+template <typename MakeLoop>
+void CheckRepeatModes(MakeLoop make_loop) {
+  const std::vector<IntervalNs> work_times(4, milliseconds{3});
+
+  const std::vector<TimestampNs> fixed_rate_times{
+      milliseconds{0}, milliseconds{10}, milliseconds{20}, milliseconds{30}};
+  MK_CHECK(RunRepeating(make_loop, RepeatMode::kFixedRate, work_times) ==
+           fixed_rate_times);
+
+  const std::vector<TimestampNs> fixed_delay_times{
+      milliseconds{0}, milliseconds{13}, milliseconds{26}, milliseconds{39}};
+  MK_CHECK(RunRepeating(make_loop, RepeatMode::kFixedDelay, work_times) ==
+           fixed_delay_times);
+
+  // Long first run misses two beats, late run starts at once and phase is
+  // kept.
+  const std::vector<IntervalNs> long_work_times{milliseconds{25}, IntervalNs{0},
+                                                IntervalNs{0}, IntervalNs{0}};
+  const std::vector<TimestampNs> missed_times{
+      milliseconds{0}, milliseconds{25}, milliseconds{30}, milliseconds{40}};
+  MK_CHECK(RunRepeating(make_loop, RepeatMode::kFixedRate, long_work_times) ==
+           missed_times);
+}
+
+template <typename MakeLoop>
+void CheckSlackCoalescing(MakeLoop make_loop) {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  auto loop = make_loop(time);
+
+  constexpr IntervalNs kSlack = milliseconds{4};
+  TimerOptions options;
+  options.slack = kSlack;
+
+  // Timers planned within 2 ms wake loop up at most twice.
+  std::vector<std::pair<TimestampNs, TimestampNs>> calls;
+  for (int i = 0; i < 20; ++i) {
+    const IntervalNs delay = milliseconds{10} + microseconds{100} * i;
+    loop->PostDelayedTask(
+        [&, delay]() { calls.emplace_back(delay, time->Now()); }, delay,
+        TaskPriority::kUserVisible, options);
+  }
+  loop->PostDelayedTask([&]() { loop->Stop(); }, std::chrono::seconds{1});
+  loop->Run();
+
+  MK_CHECK(calls.size() == 20);
+  std::set<TimestampNs> wakeup_times;
+  for (const auto& [planned_call, call] : calls) {
+    MK_CHECK(call >= planned_call && call <= planned_call + kSlack);
+    wakeup_times.insert(call);
+  }
+  MK_CHECK(wakeup_times.size() <= 2);
+}
+
+void TestCoalesceCallTime() {
+  MK_CHECK(CoalesceCallTime(milliseconds{5}, IntervalNs{0}) ==
+           milliseconds{5});
+  MK_CHECK(CoalesceCallTime(TimestampNs::max(), milliseconds{1}) ==
+           TimestampNs::max());
+
+  // Grid is the largest power of two nanoseconds not above slack.
+  MK_CHECK(CoalesceCallTime(IntervalNs{1000}, IntervalNs{1000}) ==
+           IntervalNs{1024});
+  MK_CHECK(CoalesceCallTime(IntervalNs{1024}, IntervalNs{1000}) ==
+           IntervalNs{1024});
+  MK_CHECK(CoalesceCallTime(IntervalNs{1025}, IntervalNs{1023}) ==
+           IntervalNs{1536});
+}
+}  // namespace
+}  // namespace mk
+
+int main() {
+  mk::TestCoalesceCallTime();
+
+  mk::CheckRepeatModes(mk::MakeRunLoop);
+  mk::CheckRepeatModes(mk::MakePool);
+  mk::CheckSlackCoalescing(mk::MakeRunLoop);
+  mk::CheckSlackCoalescing(mk::MakePool);
+
+  return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+/**
+ * @brief Fail test with condition and its location if condition is false.
+ *
+ */
+#define MK_CHECK(condition)                                            \
+  do {                                                                 \
+    if (!(condition)) {                                                \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: "   \
+                << #condition << "\n";                                 \
+      std::exit(EXIT_FAILURE);                                         \
+    }                                                                  \
+  } while (false)
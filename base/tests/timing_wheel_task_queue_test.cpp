@@ -0,0 +1,164 @@
+// Timing wheel pops every task exactly at its call time, in call time order,
+// and never pops removed tasks. Time is virtual, so delays of hours take no
+// time.
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "pending_task.h"
+#include "test_check.h"
+#include "timing_wheel_task_queue.h"
+#include "virtual_time_provider.h"
+
+namespace mk {
+namespace {
+using std::chrono::hours;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+/**
+ * @brief Tasks with call times spread over every wheel level and overflow.
+ *
+ */
+std::vector<std::unique_ptr<PendingTask>> MakeTasks(TimestampNs start,
+                                                    std::size_t count) {
+  std::mt19937_64 random{42};
+  const std::vector<IntervalNs> ranges{microseconds{10}, milliseconds{1},
+                                       milliseconds{100}, seconds{10},
+                                       hours{10}};
+
+  std::vector<std::unique_ptr<PendingTask>> tasks;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto range = ranges[i % ranges.size()].count();
+    const auto delay = IntervalNs{static_cast<IntervalNs::rep>(
+        random() % static_cast<std::uint64_t>(range))};
+    tasks.push_back(
+        std::make_unique<PendingTask>(Task{[]() {}}, start + delay));
+  }
+
+  return tasks;
+}
+
+/**
+ * @brief Advance time like idle loop does and pop the next task.
+ *
+ * Loop wakes up at most once per wheel level on the way to distant task.
+ *
+ */
+PendingTask* PopNext(TaskQueue& queue, VirtualTimeProvider& time) {
+  while (queue.GetNextTaskCallTime() > time.Now()) {
+    time.AdvanceTo(queue.GetNextTaskCallTime());
+  }
+
+  auto* task = queue.PopTask();
+
+  // Task is neither early nor late.
+  MK_CHECK(task->next_call == time.Now());
+  return task;
+}
+
+/**
+ * @brief Pop all tasks.
+ *
+ * @return Popped tasks in pop order.
+ */
+std::vector<PendingTask*> PopAll(TaskQueue& queue, VirtualTimeProvider& time) {
+  std::vector<PendingTask*> popped;
+  while (!queue.IsEmpty()) {
+    popped.push_back(PopNext(queue, time));
+  }
+
+  return popped;
+}
+
+void TestPopsInCallTimeOrder() {
+  auto time = std::make_shared<VirtualTimeProvider>(hours{1});
+  TimingWheelTaskQueue queue{time};
+
+  auto tasks = MakeTasks(time->Now(), 5000);
+  for (auto& task : tasks) {
+    queue.AddTask(task.get());
+  }
+
+  const auto popped = PopAll(queue, *time);
+  MK_CHECK(popped.size() == tasks.size());
+  MK_CHECK(std::is_sorted(
+      popped.begin(), popped.end(),
+      [](const PendingTask* left, const PendingTask* right) {
+        return left->next_call < right->next_call;
+      }));
+}
+
+void TestRemovedTasksAreNotPopped() {
+  auto time = std::make_shared<VirtualTimeProvider>(hours{1});
+  TimingWheelTaskQueue queue{time};
+
+  auto tasks = MakeTasks(time->Now(), 3000);
+  for (auto& task : tasks) {
+    queue.AddTask(task.get());
+  }
+
+  // Remove every third task from all levels and overflow.
+  for (std::size_t i = 0; i < tasks.size(); i += 3) {
+    queue.RemoveTask(tasks[i].get());
+    tasks[i]->times = 0;
+  }
+
+  const auto popped = PopAll(queue, *time);
+  MK_CHECK(popped.size() == tasks.size() - (tasks.size() + 2) / 3);
+  for (const auto* task : popped) {
+    MK_CHECK(task->times != 0);
+  }
+}
+
+void TestTasksAddedWhileRunning() {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  TimingWheelTaskQueue queue{time};
+
+  // Every popped task adds the next one, like repeating task does.
+  PendingTask task{Task{[]() {}}, time->Now() + milliseconds{3}};
+  queue.AddTask(&task);
+
+  for (int i = 0; i < 1000; ++i) {
+    MK_CHECK(PopNext(queue, *time) == &task);
+
+    task.next_call = time->Now() + milliseconds{3};
+    queue.AddTask(&task);
+  }
+
+  MK_CHECK(time->Now() == milliseconds{3000});
+}
+
+void TestWheelSkipsIdlePeriod() {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  TimingWheelTaskQueue queue{time};
+
+  PendingTask first_task{Task{[]() {}}, time->Now() + milliseconds{1}};
+  queue.AddTask(&first_task);
+  MK_CHECK(PopNext(queue, *time) == &first_task);
+
+  // Task added after long idle period is due at its own time, not when
+  // wheel catches up.
+  time->Advance(hours{100});
+  PendingTask second_task{Task{[]() {}}, time->Now() + microseconds{100}};
+  queue.AddTask(&second_task);
+  MK_CHECK(queue.GetNextTaskCallTime() == second_task.next_call);
+
+  MK_CHECK(PopNext(queue, *time) == &second_task);
+  MK_CHECK(queue.IsEmpty());
+}
+}  // namespace
+}  // namespace mk
+
+int main() {
+  mk::TestPopsInCallTimeOrder();
+  mk::TestRemovedTasksAreNotPopped();
+  mk::TestTasksAddedWhileRunning();
+  mk::TestWheelSkipsIdlePeriod();
+
+  return 0;
+}
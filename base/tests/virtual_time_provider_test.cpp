@@ -0,0 +1,142 @@
+// Loops paired with virtual time fast-forward through delayed and repeating
+// tasks, so hours of timers take no real time and run exactly on time.
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "priority_task_queue.h"
+#include "run_loop.h"
+#include "run_loop_ui.h"
+#include "task_pump_virtual.h"
+#include "test_check.h"
+#include "thread_pool_run_loop.h"
+#include "timing_wheel_task_queue.h"
+#include "virtual_time_provider.h"
+
+namespace mk {
+namespace {
+using std::chrono::hours;
+using std::chrono::minutes;
+
+const std::vector<TimestampNs> kExpectedCallTimes{
+    hours{0}, minutes{30}, hours{1}, hours{2}, hours{3}, hours{5}};
+
+/**
+ * @brief Post delayed and repeating tasks which record their call times.
+ *
+ */
+template <typename Loop>
+void PostTimers(Loop& loop, const TimeProvider& time,
+                std::vector<TimestampNs>& call_times) {
+  const auto record = [&time, &call_times]() {
+    call_times.push_back(time.Now());
+  };
+
+  loop.PostDelayedTask(record, hours{5});
+  loop.PostDelayedTask(record, minutes{30});
+  loop.PostRepeatingTask(record, 3, hours{1}, TaskPriority::kUserVisible,
+                         TimerOptions{RepeatMode::kFixedRate, IntervalNs{0}});
+  loop.PostDelayedTask(record, hours{3});
+  loop.PostDelayedTask([&loop]() { loop.Stop(); }, hours{10});
+}
+
+void CheckTimers(const std::vector<TimestampNs>& call_times,
+                 std::chrono::steady_clock::time_point start) {
+  MK_CHECK(call_times == kExpectedCallTimes);
+  MK_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds{5});
+}
+
+void TestTimeMovesOnlyForward() {
+  VirtualTimeProvider time{hours{1}};
+  MK_CHECK(time.Now() == hours{1});
+
+  time.Advance(minutes{1});
+  MK_CHECK(time.Now() == hours{1} + minutes{1});
+
+  time.AdvanceTo(hours{1});
+  MK_CHECK(time.Now() == hours{1} + minutes{1});
+
+  time.AdvanceTo(hours{2});
+  MK_CHECK(time.Now() == hours{2});
+}
+
+void TestRunLoop() {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  RunLoop loop{std::make_unique<TaskPumpVirtual>(time),
+               std::make_unique<TimingWheelTaskQueue>(time), time};
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<TimestampNs> call_times;
+  PostTimers(loop, *time, call_times);
+  loop.Run();
+
+  CheckTimers(call_times, start);
+  MK_CHECK(time->Now() == hours{10});
+}
+
+void TestThreadPoolRunLoop() {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  ThreadPoolRunLoop pool{ThreadPoolOptions{1},
+                         std::make_unique<TimingWheelTaskQueue>(time), time,
+                         std::make_shared<TaskPumpVirtual>(time)};
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<TimestampNs> call_times;
+  PostTimers(pool, *time, call_times);
+  pool.Run();
+
+  CheckTimers(call_times, start);
+}
+
+void TestRunLoopUi() {
+  auto time_provider = std::make_unique<VirtualTimeProvider>();
+  auto& time = *time_provider;
+  RunLoopUi loop{RunLoopUiOptions{}, std::make_unique<PriorityTaskQueue>(),
+                 std::move(time_provider)};
+
+  // Backend waiter advances time instead of waiting. Loop always has a
+  // delayed task here, so the wait is never infinite.
+  loop.SetBackendTask(
+      []() { return RunLoopBackendExecutor::IterationStatus::Idle; });
+  loop.SetBackendWaiter([&time](IntervalNs timeout) { time.Advance(timeout); },
+                        []() {});
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<TimestampNs> call_times;
+  PostTimers(loop, time, call_times);
+  loop.Run();
+
+  CheckTimers(call_times, start);
+}
+
+void TestLoopWithoutTimersWaitsForPost() {
+  auto time = std::make_shared<VirtualTimeProvider>();
+  RunLoop loop{std::make_unique<TaskPumpVirtual>(time),
+               std::make_unique<PriorityTaskQueue>(), time};
+  std::thread loop_thread{[&loop]() { loop.Run(); }};
+
+  // Idle loop without delayed tasks doesn't move time.
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+  TimestampNs call_time{-1};
+  loop.PostTask([&]() {
+    call_time = time->Now();
+    loop.Stop();
+  });
+  loop_thread.join();
+
+  MK_CHECK(call_time == TimestampNs{0});
+}
+}  // namespace
+}  // namespace mk
+
+int main() {
+  mk::TestTimeMovesOnlyForward();
+  mk::TestRunLoop();
+  mk::TestThreadPoolRunLoop();
+  mk::TestRunLoopUi();
+  mk::TestLoopWithoutTimersWaitsForPost();
+
+  return 0;
+}
@@ -0,0 +1,202 @@
+#include "thread.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+#include <utility>
+
+namespace mk {
+namespace {
+#if defined(__linux__)
+/// Longest thread name without terminating zero.
+constexpr std::size_t kMaxNameLength = 15;
+
+/**
+ * @brief Thread start arguments owned by started thread.
+ *
+ */
+struct ThreadStart {
+  ThreadOptions options;
+  std::function<void()> function;
+};
+
+void* RunThread(void* argument) {
+  const std::unique_ptr<ThreadStart> start{
+      static_cast<ThreadStart*>(argument)};
+  ApplyThreadOptions(start->options);
+  start->function();
+
+  return nullptr;
+}
+
+bool IsRealTime(ThreadSchedulingPolicy policy) {
+  return policy == ThreadSchedulingPolicy::kFifo ||
+         policy == ThreadSchedulingPolicy::kRoundRobin;
+}
+
+int ToSchedulingPolicy(ThreadSchedulingPolicy policy) {
+  switch (policy) {
+    case ThreadSchedulingPolicy::kNormal:
+      return SCHED_OTHER;
+    case ThreadSchedulingPolicy::kBatch:
+      return SCHED_BATCH;
+    case ThreadSchedulingPolicy::kIdle:
+      return SCHED_IDLE;
+    case ThreadSchedulingPolicy::kFifo:
+      return SCHED_FIFO;
+    case ThreadSchedulingPolicy::kRoundRobin:
+      return SCHED_RR;
+  }
+
+  return SCHED_OTHER;
+}
+
+void KeepFirstError(std::error_code& error, int result) {
+  if (!error && result != 0) {
+    error = std::error_code{result, std::generic_category()};
+  }
+}
+#endif
+}  // namespace
+
+std::error_code ApplyThreadOptions(const ThreadOptions& options) {
+#if defined(__linux__)
+  std::error_code error;
+  const auto self = pthread_self();
+
+  if (!options.name.empty()) {
+    const auto name = options.name.substr(0, kMaxNameLength);
+    KeepFirstError(error, pthread_setname_np(self, name.c_str()));
+  }
+
+  if (!options.cpu_affinity.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const auto cpu : options.cpu_affinity) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpus);
+      }
+    }
+    KeepFirstError(error, pthread_setaffinity_np(self, sizeof(cpus), &cpus));
+  }
+
+  const auto is_real_time = IsRealTime(options.scheduling_policy);
+  if (options.scheduling_policy != ThreadSchedulingPolicy::kNormal) {
+    sched_param parameters{};
+    parameters.sched_priority = is_real_time ? options.priority : 0;
+    KeepFirstError(
+        error, pthread_setschedparam(
+                   self, ToSchedulingPolicy(options.scheduling_policy),
+                   &parameters));
+  }
+
+  if (!is_real_time && options.priority != 0) {
+    // Linux keeps nice value per thread.
+    const auto result = setpriority(
+        PRIO_PROCESS, static_cast<id_t>(gettid()), options.priority);
+    KeepFirstError(error, result != 0 ? errno : 0);
+  }
+
+  return error;
+#else
+  const auto is_default =
+      options.name.empty() && options.cpu_affinity.empty() &&
+      options.scheduling_policy == ThreadSchedulingPolicy::kNormal &&
+      options.priority == 0;
+
+  return is_default ? std::error_code{}
+                    : std::make_error_code(std::errc::not_supported);
+#endif
+}
+
+#if defined(__linux__)
+Thread::Thread() : handle_{}, is_joinable_{false} {}
+
+Thread::Thread(ThreadOptions options, std::function<void()> function)
+    : handle_{}, is_joinable_{false} {
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  if (options.stack_size != 0) {
+    pthread_attr_setstacksize(
+        &attributes,
+        std::max(options.stack_size,
+                 static_cast<std::size_t>(PTHREAD_STACK_MIN)));
+  }
+
+  auto start = std::make_unique<ThreadStart>(
+      ThreadStart{std::move(options), std::move(function)});
+  const auto result =
+      pthread_create(&handle_, &attributes, &RunThread, start.get());
+  pthread_attr_destroy(&attributes);
+
+  if (result != 0) {
+    throw std::system_error{result, std::generic_category(), "pthread_create"};
+  }
+
+  // Started thread owns its arguments.
+  start.release();
+  is_joinable_ = true;
+}
+
+Thread::~Thread() { Join(); }
+
+Thread::Thread(Thread&& other) noexcept
+    : handle_{other.handle_},
+      is_joinable_{std::exchange(other.is_joinable_, false)} {}
+
+Thread& Thread::operator=(Thread&& other) noexcept {
+  if (this != &other) {
+    Join();
+    handle_ = other.handle_;
+    is_joinable_ = std::exchange(other.is_joinable_, false);
+  }
+
+  return *this;
+}
+
+bool Thread::IsJoinable() const { return is_joinable_; }
+
+void Thread::Join() {
+  if (is_joinable_) {
+    pthread_join(handle_, nullptr);
+    is_joinable_ = false;
+  }
+}
+#else
+Thread::Thread() = default;
+
+Thread::Thread(ThreadOptions options, std::function<void()> function)
+    : thread_{[options = std::move(options),
+               function = std::move(function)]() {
+        ApplyThreadOptions(options);
+        function();
+      }} {}
+
+Thread::~Thread() { Join(); }
+
+Thread::Thread(Thread&& other) noexcept = default;
+
+Thread& Thread::operator=(Thread&& other) noexcept {
+  if (this != &other) {
+    Join();
+    thread_ = std::move(other.thread_);
+  }
+
+  return *this;
+}
+
+bool Thread::IsJoinable() const { return thread_.joinable(); }
+
+void Thread::Join() {
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+#endif
+}  // namespace mk
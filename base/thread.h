@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <system_error>
+
+#if defined(__linux__)
+#include <pthread.h>
+#else
+#include <thread>
+#endif
+
+#include "thread_options.h"
+
+namespace mk {
+/**
+ * @brief Apply options to calling thread. Stack size is ignored.
+ *
+ * Every option is applied even if previous one fails.
+ *
+ * @param options Thread options.
+ * @return First error.
+ */
+std::error_code ApplyThreadOptions(const ThreadOptions& options);
+
+/**
+ * @brief Thread created with ThreadOptions.
+ *
+ * Joins in destructor if it wasn't joined before.
+ *
+ */
+class Thread {
+ public:
+  Thread();
+
+  /**
+   * @brief Start thread.
+   *
+   * Throws std::system_error if thread can't be created.
+   *
+   * @param options Thread options.
+   * @param function Thread function.
+   */
+  Thread(ThreadOptions options, std::function<void()> function);
+  ~Thread();
+
+  Thread(Thread&& other) noexcept;
+  Thread& operator=(Thread&& other) noexcept;
+
+  Thread(const Thread&) = delete;
+  Thread& operator=(const Thread&) = delete;
+
+  bool IsJoinable() const;
+  void Join();
+
+ private:
+#if defined(__linux__)
+  pthread_t handle_;
+  bool is_joinable_;
+#else
+  std::thread thread_;
+#endif
+};
+}  // namespace mk
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mk {
+/**
+ * @brief Thread scheduling class.
+ *
+ */
+enum class ThreadSchedulingPolicy {
+  kNormal,      ///< Default time sharing.
+  kBatch,       ///< Time sharing for CPU bound non-interactive work.
+  kIdle,        ///< Runs only when nothing else wants CPU.
+  kFifo,        ///< Real time, runs until it blocks or yields.
+  kRoundRobin,  ///< Real time with time slices.
+};
+
+/**
+ * @brief Thread configuration.
+ *
+ * Options which process isn't permitted to apply, e.g. real time policy
+ * without privileges, are skipped and thread runs with defaults.
+ *
+ */
+struct ThreadOptions {
+  /// Name shown in debuggers, top and perf. Linux keeps first 15 characters.
+  std::string name;
+
+  /// CPUs thread may run on. Empty means any CPU.
+  std::vector<std::size_t> cpu_affinity;
+
+  ThreadSchedulingPolicy scheduling_policy{ThreadSchedulingPolicy::kNormal};
+
+  /// Nice value for time sharing policies, real time priority otherwise.
+  int priority{0};
+
+  /// Stack size in bytes. Zero means platform default.
+  std::size_t stack_size{0};
+};
+}  // namespace mk
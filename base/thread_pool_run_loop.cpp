@@ -0,0 +1,680 @@
+#include "thread_pool_run_loop.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "task_pump_std.h"
+#include "task_queue.h"
+#include "task_schedule.h"
+#include "task_watchdog.h"
+#include "thread.h"
+#include "time_provider.h"
+#include "trace_log.h"
+
+namespace mk {
+namespace {
+thread_local const ThreadPoolRunLoop* current_pool = nullptr;
+thread_local std::size_t current_worker_index = 0;
+}  // namespace
+
+ThreadPoolRunLoop::ThreadPoolRunLoop(ThreadPoolOptions options,
+                                     std::unique_ptr<TaskQueue> task_queue,
+                                     std::shared_ptr<TimeProvider> time_provider)
+    : ThreadPoolRunLoop{std::move(options), std::move(task_queue),
+                        std::move(time_provider),
+                        std::make_shared<TaskPumpStd>()} {}
+
+ThreadPoolRunLoop::ThreadPoolRunLoop(ThreadPoolOptions options,
+                                     std::unique_ptr<TaskQueue> task_queue,
+                                     std::shared_ptr<TimeProvider> time_provider,
+                                     std::shared_ptr<TaskPump> timer_pump)
+    : thread_options_{std::move(options.thread_options)},
+      delayed_queue_{std::move(task_queue)},
+      time_provider_{std::move(time_provider)},
+      timer_pump_{std::move(timer_pump)},
+      has_timer_owner_{false},
+      wake_ups_count_{0},
+      ready_tasks_count_{0},
+      idle_workers_count_{0},
+      next_worker_{0},
+      is_running_{false},
+      capacity_{options.capacity, options.overflow_policy} {
+  const auto workers_count = std::max<std::size_t>(options.workers_count, 1);
+
+  workers_.reserve(workers_count);
+  for (std::size_t i = 0; i < workers_count; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+}
+
+void ThreadPoolRunLoop::Run() {
+  is_running_ = true;
+
+  std::vector<Thread> threads;
+  threads.reserve(workers_.size() - 1);
+  for (std::size_t i = 1; i < workers_.size(); ++i) {
+    auto thread_options = thread_options_;
+    if (!thread_options.name.empty()) {
+      thread_options.name += std::to_string(i);
+    }
+
+    threads.emplace_back(std::move(thread_options),
+                         [this, i]() { RunWorker(i); });
+  }
+
+  RunWorker(0);
+
+  for (auto& thread : threads) {
+    thread.Join();
+  }
+}
+
+void ThreadPoolRunLoop::Stop() {
+  is_running_ = false;
+
+  // Blocked posters give up waiting for stopped pool.
+  capacity_.WakeUpBlocked();
+
+  std::lock_guard lock{idle_guard_};
+  idle_event_.notify_all();
+  timer_pump_->Notify();
+}
+
+void ThreadPoolRunLoop::SetWatchdog(TaskWatchdog& watchdog,
+                                    const std::string& name) {
+  heartbeats_.clear();
+  for (std::size_t i = 0; i < workers_.size(); ++i) {
+    heartbeats_.push_back(watchdog.AddLoopThread(name));
+  }
+}
+
+void ThreadPoolRunLoop::SetMetrics(MetricsRegistry& registry,
+                                   const std::string& name) {
+  metrics_ = TaskLoopMetrics{registry, name};
+}
+
+TaskHandle ThreadPoolRunLoop::PostTask(Task task, TaskPriority priority) {
+  if (!AcquireCapacity()) {
+    return {};
+  }
+
+  auto* pending_task = pool_.Acquire(std::move(task), 1, IntervalNs{0},
+                                     time_provider_->Now(), priority);
+  TaskHandle handle{*pending_task};
+  PushReadyTask(pending_task);
+
+  return handle;
+}
+
+std::vector<TaskHandle> ThreadPoolRunLoop::PostTasks(std::vector<Task> tasks,
+                                                     TaskPriority priority) {
+  if (tasks.empty()) {
+    return {};
+  }
+
+  const auto now = time_provider_->Now();
+
+  std::vector<TaskHandle> handles;
+  handles.reserve(tasks.size());
+
+  std::vector<PendingTask*> pending_tasks;
+  pending_tasks.reserve(tasks.size());
+  for (auto& task : tasks) {
+    if (!capacity_.TryAcquire()) {
+      // Workers take tasks posted so far while poster waits for capacity.
+      PushReadyTasks(pending_tasks, priority);
+      pending_tasks.clear();
+
+      if (!AcquireCapacity()) {
+        handles.emplace_back();
+        continue;
+      }
+    }
+
+    auto* pending_task =
+        pool_.Acquire(std::move(task), 1, IntervalNs{0}, now, priority);
+    handles.emplace_back(*pending_task);
+    pending_tasks.push_back(pending_task);
+  }
+
+  PushReadyTasks(pending_tasks, priority);
+
+  return handles;
+}
+
+TaskHandle ThreadPoolRunLoop::PostRepeatingTask(Task task, size_t times,
+                                                IntervalNs period,
+                                                TaskPriority priority,
+                                                TimerOptions options) {
+  return PostTask(std::move(task), times, period, time_provider_->Now(),
+                  priority, options);
+}
+
+TaskHandle ThreadPoolRunLoop::PostDelayedTask(Task task, IntervalNs delay,
+                                              TaskPriority priority,
+                                              TimerOptions options) {
+  return PostTask(std::move(task), 1, IntervalNs{0},
+                  time_provider_->Now() + delay, priority, options);
+}
+
+void ThreadPoolRunLoop::CancelTask(TaskHandle&& handle) {
+  // Task state is destroyed out of lock, it may post or cancel tasks.
+  Task cancelled_task;
+  {
+    std::lock_guard lock{task_quard_};
+    auto* task_ptr = pool_.Find(handle);
+    if (!task_ptr) {
+      return;
+    }
+
+    std::unique_lock delayed_lock{delayed_guard_};
+    if (task_ptr->queue_index == PendingTask::kNotQueued) {
+      delayed_lock.unlock();
+
+      // Task which is running or moving between queues is only marked, it is
+      // released by its worker without run.
+      cancelled_task = std::move(task_ptr->task);
+      task_ptr->times = 0;
+
+      const auto index = task_ptr->worker_index.load(std::memory_order_relaxed);
+      if (index == PendingTask::kNotQueued) {
+        return;
+      }
+
+      auto& worker = *workers_[index];
+      std::lock_guard worker_lock{worker.guard};
+      if (task_ptr->worker_index.load(std::memory_order_relaxed) != index) {
+        // Task has been taken while worker guard was awaited.
+        return;
+      }
+
+      auto& lane = worker.lanes[ToIndex(task_ptr->priority)];
+      lane.erase(std::find(lane.begin(), lane.end(), task_ptr));
+      task_ptr->worker_index.store(PendingTask::kNotQueued,
+                                   std::memory_order_relaxed);
+      --ready_tasks_count_;
+      pool_.Release(task_ptr);
+      capacity_.Release(1);
+      return;
+    }
+
+    const auto call_time = delayed_queue_->GetNextTaskCallTime();
+    delayed_queue_->RemoveTask(task_ptr);
+    cancelled_task = std::move(task_ptr->task);
+    pool_.Release(task_ptr);
+
+    if (!delayed_queue_->IsEmpty() &&
+        delayed_queue_->GetNextTaskCallTime() == call_time) {
+      return;
+    }
+  }
+
+  // Let timer owner recalculate wake up time without removed task.
+  WakeUpTimerOwner();
+}
+
+void ThreadPoolRunLoop::UpdateTaskPriority(const TaskHandle& handle,
+                                           TaskPriority priority) {
+  std::lock_guard lock{task_quard_};
+  auto* task_ptr = pool_.Find(handle);
+  if (!task_ptr) {
+    return;
+  }
+
+  {
+    std::lock_guard delayed_lock{delayed_guard_};
+    if (task_ptr->queue_index != PendingTask::kNotQueued) {
+      // Task will be pushed to proper lane when it is ready.
+      task_ptr->priority = priority;
+      return;
+    }
+  }
+
+  // Priority of ready task is changed only under guard of the worker which
+  // holds it. Task which is running or moving between queues keeps priority.
+  const auto index = task_ptr->worker_index.load(std::memory_order_relaxed);
+  if (index == PendingTask::kNotQueued) {
+    return;
+  }
+
+  auto& worker = *workers_[index];
+  std::lock_guard worker_lock{worker.guard};
+  if (task_ptr->worker_index.load(std::memory_order_relaxed) != index) {
+    // Task has been taken while worker guard was awaited.
+    return;
+  }
+
+  auto& lane = worker.lanes[ToIndex(task_ptr->priority)];
+  const auto it = std::find(lane.begin(), lane.end(), task_ptr);
+  if (it != lane.end()) {
+    lane.erase(it);
+    task_ptr->priority = priority;
+    worker.lanes[ToIndex(priority)].push_back(task_ptr);
+  }
+}
+
+TaskHandle ThreadPoolRunLoop::PostCoalescedTask(const std::string& key,
+                                                Task task,
+                                                TaskPriority priority) {
+  // Task state is destroyed out of lock, it may post or cancel tasks.
+  Task replaced_task;
+  {
+    std::lock_guard coalesced_lock{coalesced_guard_};
+    std::lock_guard lock{task_quard_};
+    if (auto* task_ptr =
+            ReplaceCoalescedTaskLocked(key, task, priority, replaced_task)) {
+      return TaskHandle{*task_ptr};
+    }
+  }
+
+  // Poster may wait for capacity, so it is taken out of guards.
+  if (!AcquireCapacity()) {
+    return {};
+  }
+
+  TaskHandle handle;
+  auto is_replaced = false;
+  {
+    std::lock_guard coalesced_lock{coalesced_guard_};
+    {
+      std::lock_guard lock{task_quard_};
+      if (auto* task_ptr =
+              ReplaceCoalescedTaskLocked(key, task, priority, replaced_task)) {
+        // Task with the key has been posted meanwhile.
+        handle = TaskHandle{*task_ptr};
+        is_replaced = true;
+      }
+    }
+
+    if (!is_replaced) {
+      auto* pending_task = pool_.Acquire(std::move(task), 1, IntervalNs{0},
+                                         time_provider_->Now(), priority);
+      handle = TaskHandle{*pending_task};
+      coalesced_tasks_[key] = handle;
+      PushReadyTask(pending_task);
+    }
+  }
+
+  if (is_replaced) {
+    // Replaced task holds capacity already.
+    capacity_.Release(1);
+  }
+
+  return handle;
+}
+
+TaskHandle ThreadPoolRunLoop::PostTask(Task task, size_t times,
+                                       IntervalNs period, TimestampNs when,
+                                       TaskPriority priority,
+                                       TimerOptions options) {
+  auto* pending_task = pool_.Acquire(std::move(task), times, period, when,
+                                     priority, options);
+  TaskHandle handle{*pending_task};
+  PushDelayedTask(pending_task);
+
+  return handle;
+}
+
+void ThreadPoolRunLoop::PushReadyTask(PendingTask* task) {
+  const auto index = current_pool == this
+                         ? current_worker_index
+                         : next_worker_.fetch_add(1) % workers_.size();
+
+  {
+    auto& worker = *workers_[index];
+    std::lock_guard lock{worker.guard};
+    worker.lanes[ToIndex(task->priority)].push_back(task);
+    task->worker_index.store(index, std::memory_order_relaxed);
+  }
+
+  ++ready_tasks_count_;
+  WakeUpWorker();
+}
+
+void ThreadPoolRunLoop::PushReadyTasks(const std::vector<PendingTask*>& tasks,
+                                       TaskPriority priority) {
+  if (tasks.empty()) {
+    return;
+  }
+
+  // Whole batch goes to one worker, idle workers steal their share.
+  const auto index = current_pool == this
+                         ? current_worker_index
+                         : next_worker_.fetch_add(1) % workers_.size();
+  {
+    auto& worker = *workers_[index];
+    std::lock_guard lock{worker.guard};
+    auto& lane = worker.lanes[ToIndex(priority)];
+    // Worker pops own tasks from the back.
+    lane.insert(lane.end(), tasks.rbegin(), tasks.rend());
+    for (auto* task : tasks) {
+      task->worker_index.store(index, std::memory_order_relaxed);
+    }
+  }
+
+  ready_tasks_count_ += tasks.size();
+
+  if (idle_workers_count_ > 0) {
+    std::lock_guard lock{idle_guard_};
+    WakeUpWorkersLocked(tasks.size());
+  }
+}
+
+void ThreadPoolRunLoop::PushDelayedTask(PendingTask* task) {
+  {
+    std::lock_guard lock{delayed_guard_};
+    delayed_queue_->AddTask(task);
+  }
+
+  WakeUpTimerOwner();
+}
+
+void ThreadPoolRunLoop::RunWorker(std::size_t index) {
+  current_pool = this;
+  current_worker_index = index;
+
+  while (is_running_) {
+    auto* pending_task = PopOwnTask(index);
+
+    if (!pending_task) {
+      pending_task = PopReadyDelayedTask(index);
+    }
+
+    if (!pending_task) {
+      pending_task = StealTask(index);
+    }
+
+    if (pending_task) {
+      RunPendingTask(pending_task);
+    } else {
+      WaitForTasks();
+    }
+  }
+
+  current_pool = nullptr;
+}
+
+void ThreadPoolRunLoop::RunPendingTask(PendingTask* pending_task) {
+  Task task;
+  {
+    std::lock_guard lock{task_quard_};
+    if (pending_task->times == 0) {
+      // Task has been cancelled after it was taken from deque.
+      pool_.Release(pending_task);
+      return;
+    }
+
+    task = std::move(pending_task->task);
+  }
+
+  {
+    ScopedTaskTrace trace{*pending_task};
+    ScopedTaskHeartbeat heartbeat{
+        heartbeats_.empty() ? nullptr
+                            : heartbeats_[current_worker_index].get(),
+        task.GetLocation()};
+    task();
+  }
+  metrics_.TasksRun(1, ready_tasks_count_.load(std::memory_order_relaxed));
+
+  {
+    std::lock_guard lock{task_quard_};
+    if (!is_running_ || pending_task->times <= 1) {
+      pool_.Release(pending_task);
+      return;
+    }
+
+    --pending_task->times;
+    pending_task->task = std::move(task);
+  }
+
+  ScheduleNextCall(*pending_task, time_provider_->Now());
+  PushDelayedTask(pending_task);
+}
+
+PendingTask* ThreadPoolRunLoop::PopOwnTask(std::size_t index) {
+  auto& worker = *workers_[index];
+  std::lock_guard lock{worker.guard};
+
+  unsigned non_empty_lanes = 0;
+  for (std::size_t i = 0; i < kTaskPrioritiesCount; ++i) {
+    if (!worker.lanes[i].empty()) {
+      non_empty_lanes |= 1u << i;
+    }
+  }
+
+  const auto lane_index = worker.selector.Select(non_empty_lanes);
+  if (lane_index == kTaskPrioritiesCount) {
+    return nullptr;
+  }
+
+  auto& lane = worker.lanes[lane_index];
+  auto* pending_task = lane.back();
+  lane.pop_back();
+  pending_task->worker_index.store(PendingTask::kNotQueued,
+                                   std::memory_order_relaxed);
+  --ready_tasks_count_;
+  capacity_.Release(1);
+
+  return pending_task;
+}
+
+PendingTask* ThreadPoolRunLoop::StealTask(std::size_t index) {
+  for (std::size_t i = 1; i < workers_.size(); ++i) {
+    auto& victim = *workers_[(index + i) % workers_.size()];
+    std::lock_guard lock{victim.guard};
+
+    for (auto& lane : victim.lanes) {
+      if (!lane.empty()) {
+        auto* pending_task = lane.front();
+        lane.pop_front();
+        pending_task->worker_index.store(PendingTask::kNotQueued,
+                                         std::memory_order_relaxed);
+        --ready_tasks_count_;
+        capacity_.Release(1);
+
+        return pending_task;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+PendingTask* ThreadPoolRunLoop::PopReadyDelayedTask(std::size_t index) {
+  std::vector<PendingTask*> ready_tasks;
+  {
+    std::lock_guard lock{delayed_guard_};
+    const auto now = time_provider_->Now();
+
+    while (!delayed_queue_->IsEmpty() &&
+           delayed_queue_->GetNextTaskCallTime() <= now) {
+      ready_tasks.push_back(delayed_queue_->PopTask());
+    }
+  }
+
+  if (ready_tasks.empty()) {
+    return nullptr;
+  }
+
+  capacity_.Add(ready_tasks.size());
+
+  // Put ready tasks to own lanes, so the most important one runs here and
+  // the rest is shared with others.
+  auto& worker = *workers_[index];
+  for (auto* ready_task : ready_tasks) {
+    {
+      std::lock_guard lock{worker.guard};
+      worker.lanes[ToIndex(ready_task->priority)].push_back(ready_task);
+      ready_task->worker_index.store(index, std::memory_order_relaxed);
+    }
+
+    ++ready_tasks_count_;
+  }
+
+  for (std::size_t i = 1; i < ready_tasks.size(); ++i) {
+    WakeUpWorker();
+  }
+
+  return PopOwnTask(index);
+}
+
+void ThreadPoolRunLoop::WaitForTasks() {
+  std::unique_lock lock{idle_guard_};
+  ++idle_workers_count_;
+
+  if (is_running_ && ready_tasks_count_ == 0) {
+    if (has_timer_owner_) {
+      // Notification is counted, so the next ready task goes to another
+      // worker even before this one leaves.
+      idle_event_.wait(lock, [this]() {
+        return wake_ups_count_ != 0 || !is_running_;
+      });
+      if (wake_ups_count_ != 0) {
+        --wake_ups_count_;
+      }
+    } else {
+      auto call_time = TimestampNs::max();
+      {
+        std::lock_guard delayed_lock{delayed_guard_};
+        if (!delayed_queue_->IsEmpty()) {
+          call_time = delayed_queue_->GetNextTaskCallTime();
+        }
+      }
+
+      // Single worker waits for delayed tasks and pump watchers, it wakes up
+      // others when tasks are ready. Pump remembers notification sent before
+      // it waits.
+      has_timer_owner_ = true;
+      lock.unlock();
+      timer_pump_->WaitUntil(call_time);
+      lock.lock();
+      has_timer_owner_ = false;
+
+      // Owner may be busy with ready tasks for a while, another idle worker
+      // takes the timer over.
+      if (idle_workers_count_ - wake_ups_count_ > 1) {
+        ++wake_ups_count_;
+        idle_event_.notify_one();
+      }
+    }
+  }
+
+  --idle_workers_count_;
+}
+
+void ThreadPoolRunLoop::WakeUpWorker() {
+  if (idle_workers_count_ > 0) {
+    std::lock_guard lock{idle_guard_};
+    WakeUpWorkersLocked(1);
+  }
+}
+
+void ThreadPoolRunLoop::WakeUpWorkersLocked(std::size_t tasks_count) {
+  const auto waiting_count =
+      idle_workers_count_ - wake_ups_count_ - (has_timer_owner_ ? 1u : 0u);
+  if (waiting_count == 0) {
+    // Timer owner takes ready tasks only if nobody else waits.
+    timer_pump_->Notify();
+    return;
+  }
+
+  const auto wake_ups_count = std::min(tasks_count, waiting_count);
+  wake_ups_count_ += wake_ups_count;
+  for (std::size_t i = 0; i < wake_ups_count; ++i) {
+    idle_event_.notify_one();
+  }
+}
+
+void ThreadPoolRunLoop::WakeUpTimerOwner() {
+  if (idle_workers_count_ > 0) {
+    std::lock_guard lock{idle_guard_};
+    if (has_timer_owner_) {
+      timer_pump_->Notify();
+    } else if (idle_workers_count_ > wake_ups_count_) {
+      ++wake_ups_count_;
+      idle_event_.notify_one();
+    }
+  }
+}
+
+bool ThreadPoolRunLoop::AcquireCapacity() {
+  return capacity_.TryAcquire() ||
+         capacity_.Acquire(
+             current_pool == this, is_running_,
+             [this]() { return DropOldestTask(); },
+             [this]() { WakeUpWorker(); });
+}
+
+bool ThreadPoolRunLoop::DropOldestTask() {
+  Task dropped_task;
+
+  std::lock_guard lock{task_quard_};
+  // Lowest priority lanes go first, their fronts hold oldest tasks.
+  for (auto lane_index = kTaskPrioritiesCount; lane_index-- > 0;) {
+    for (auto& worker : workers_) {
+      std::lock_guard worker_lock{worker->guard};
+      auto& lane = worker->lanes[lane_index];
+      const auto it = std::find_if(
+          lane.begin(), lane.end(),
+          [](const PendingTask* task) { return task->times <= 1; });
+      if (it == lane.end()) {
+        continue;
+      }
+
+      auto* task_ptr = *it;
+      lane.erase(it);
+      task_ptr->worker_index.store(PendingTask::kNotQueued,
+                                   std::memory_order_relaxed);
+      --ready_tasks_count_;
+
+      // Destroy task state out of lock, it may post or cancel tasks.
+      dropped_task = std::move(task_ptr->task);
+      pool_.Release(task_ptr);
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+PendingTask* ThreadPoolRunLoop::ReplaceCoalescedTaskLocked(
+    const std::string& key, Task& task, TaskPriority priority,
+    Task& replaced_task) {
+  const auto it = coalesced_tasks_.find(key);
+  if (it == coalesced_tasks_.end()) {
+    return nullptr;
+  }
+
+  // Cancelled task waits in deque with no work, so it isn't reused.
+  auto* task_ptr = pool_.Find(it->second);
+  if (!task_ptr || task_ptr->times == 0) {
+    return nullptr;
+  }
+
+  const auto index = task_ptr->worker_index.load(std::memory_order_relaxed);
+  if (index == PendingTask::kNotQueued) {
+    return nullptr;
+  }
+
+  auto& worker = *workers_[index];
+  std::lock_guard worker_lock{worker.guard};
+  if (task_ptr->worker_index.load(std::memory_order_relaxed) != index) {
+    // Task has been taken while worker guard was awaited.
+    return nullptr;
+  }
+
+  // Ready task keeps its place in deque and takes new work.
+  replaced_task = std::exchange(task_ptr->task, std::move(task));
+  if (task_ptr->priority != priority) {
+    auto& lane = worker.lanes[ToIndex(task_ptr->priority)];
+    lane.erase(std::find(lane.begin(), lane.end(), task_ptr));
+    task_ptr->priority = priority;
+    worker.lanes[ToIndex(priority)].push_back(task_ptr);
+  }
+
+  return task_ptr;
+}
+}  // namespace mk
\ No newline at end of file
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dispatch_task.h"
+#include "pending_task.h"
+#include "pending_task_pool.h"
+#include "task_capacity.h"
+#include "task_lanes.h"
+#include "task_loop.h"
+#include "task_loop_metrics.h"
+#include "thread_options.h"
+
+namespace mk {
+class TaskHeartbeat;
+class TaskPump;
+class TaskQueue;
+class TimeProvider;
+
+/**
+ * @brief Thread pool configuration.
+ *
+ */
+struct ThreadPoolOptions {
+  std::size_t workers_count{1};  ///< Amount of worker threads (Run() caller included).
+
+  /// Options of spawned workers. Worker index is appended to their name.
+  /// Run() caller thread keeps own options.
+  ThreadOptions thread_options;
+
+  /// Most ready tasks waiting to start. Zero means unbounded.
+  std::size_t capacity{0};
+
+  OverflowPolicy overflow_policy{OverflowPolicy::kBlock};
+};
+
+/**
+ * @brief Processes tasks on several threads with work stealing.
+ *
+ * Every worker owns a deque of ready tasks per priority. Worker pops from the
+ * back of own deques and steals from the front of other deques when own
+ * deques are empty. Victim's highest priority deque is stolen from first.
+ * Delayed and repeating tasks wait in shared task queue until call time.
+ * Ready tasks of bounded pool are counted by TaskCapacity. Repeating tasks
+ * are never dropped.
+ *
+ * One idle worker, timer owner, waits in timer pump until next delayed task
+ * call time, other idle workers wait for ready tasks. File descriptor
+ * watchers of TaskPumpEpoll are run by timer owner, so they are serviced
+ * while at least one worker is idle.
+ *
+ */
+class ThreadPoolRunLoop : public TaskLoop, public DispatchTask {
+ public:
+  /**
+   * @brief Create pool which waits for delayed tasks by TaskPumpStd.
+   *
+   */
+  ThreadPoolRunLoop(ThreadPoolOptions options,
+                    std::unique_ptr<TaskQueue> task_queue,
+                    std::shared_ptr<TimeProvider> time_provider);
+
+  /**
+   * @param timer_pump Pump timer owner waits in, e.g. TaskPumpEpoll with
+   * file descriptor watchers or TaskPumpVirtual for virtual time. It is not
+   * run, only waited in. Virtual time is advanced by idle timer owner while
+   * other workers may still run tasks, so exact timings need one worker.
+   */
+  ThreadPoolRunLoop(ThreadPoolOptions options,
+                    std::unique_ptr<TaskQueue> task_queue,
+                    std::shared_ptr<TimeProvider> time_provider,
+                    std::shared_ptr<TaskPump> timer_pump);
+
+  /**
+   * @brief Run worker threads. Caller thread becomes first worker.
+   *
+   * Blocks until Stop() is called and all workers are finished.
+   *
+   */
+  void Run() override;
+
+  /** @see TaskLoop. */
+  void Stop() override;
+
+  /** @see TaskLoop. */
+  void SetWatchdog(TaskWatchdog& watchdog, const std::string& name) override;
+
+  /** @see TaskLoop. */
+  void SetMetrics(MetricsRegistry& registry, const std::string& name) override;
+
+  using DispatchTask::PostDelayedTask;
+  using DispatchTask::PostRepeatingTask;
+  using DispatchTask::PostTask;
+  using DispatchTask::PostTasks;
+
+  /** @see DispatchTask. */
+  TaskHandle PostTask(Task task, TaskPriority priority) override;
+
+  /** @see DispatchTask. */
+  std::vector<TaskHandle> PostTasks(std::vector<Task> tasks,
+                                    TaskPriority priority) override;
+
+  /** @see DispatchTask. */
+  TaskHandle PostRepeatingTask(Task task, size_t times, IntervalNs period,
+                               TaskPriority priority,
+                               TimerOptions options) override;
+
+  /** @see DispatchTask. */
+  TaskHandle PostDelayedTask(Task task, IntervalNs delay,
+                             TaskPriority priority,
+                             TimerOptions options) override;
+
+  /** @see DispatchTask. */
+  void CancelTask(TaskHandle&& handle) override;
+
+  /** @see DispatchTask. */
+  void UpdateTaskPriority(const TaskHandle& handle,
+                          TaskPriority priority) override;
+
+  /**
+   * @brief Post immediate task replacing pending task with the same key.
+   *
+   * Replaced task never runs. Task which has started already isn't
+   * replaced. Every distinct key keeps small map entry while pool lives.
+   *
+   * @param key Coalescing key.
+   * @param task Task to be done.
+   * @param priority Task priority.
+   * @return Task handle. Empty if bounded pool rejects task.
+   */
+  TaskHandle PostCoalescedTask(const std::string& key, Task task,
+                               TaskPriority priority);
+
+  /** @brief Post user visible coalesced task. */
+  TaskHandle PostCoalescedTask(const std::string& key, Task task) {
+    return PostCoalescedTask(key, std::move(task), TaskPriority::kUserVisible);
+  }
+
+ private:
+  /**
+   * @brief Worker ready tasks.
+   *
+   */
+  struct Worker {
+    std::mutex guard;
+    std::array<std::deque<PendingTask*>, kTaskPrioritiesCount> lanes;
+    LaneSelector selector;
+  };
+
+  TaskHandle PostTask(Task task, size_t times, IntervalNs period,
+                      TimestampNs when, TaskPriority priority,
+                      TimerOptions options);
+
+  void PushReadyTask(PendingTask* task);
+  void PushReadyTasks(const std::vector<PendingTask*>& tasks,
+                      TaskPriority priority);
+  void PushDelayedTask(PendingTask* task);
+
+  void RunWorker(std::size_t index);
+  void RunPendingTask(PendingTask* pending_task);
+
+  PendingTask* PopOwnTask(std::size_t index);
+  PendingTask* StealTask(std::size_t index);
+  PendingTask* PopReadyDelayedTask(std::size_t index);
+
+  void WaitForTasks();
+  void WakeUpWorker();
+
+  /**
+   * @brief Wake up idle workers for ready tasks. Must be called under idle
+   * guard.
+   *
+   * @param tasks_count Ready tasks count.
+   */
+  void WakeUpWorkersLocked(std::size_t tasks_count);
+
+  /**
+   * @brief Let timer owner recalculate wake up time. If there is no owner,
+   * idle worker wakes up to become one.
+   *
+   */
+  void WakeUpTimerOwner();
+
+  /**
+   * @brief Take capacity for immediate task, applying overflow policy.
+   *
+   * @return false if task is rejected.
+   */
+  bool AcquireCapacity();
+
+  /**
+   * @brief Drop oldest ready task of lowest priority.
+   *
+   * @return true if new task may take capacity of dropped one.
+   */
+  bool DropOldestTask();
+
+  /**
+   * @brief Give new work to ready task with the key.
+   *
+   * @param key Coalescing key.
+   * @param task New work, moved from only if task is replaced.
+   * @param priority New priority.
+   * @param replaced_task Receives replaced work, so it is destroyed out of
+   * lock.
+   * @return Task which takes new work or nullptr.
+   */
+  PendingTask* ReplaceCoalescedTaskLocked(const std::string& key, Task& task,
+                                          TaskPriority priority,
+                                          Task& replaced_task);
+
+  PendingTaskPool pool_;
+  ThreadOptions thread_options_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::unique_ptr<TaskQueue> delayed_queue_;
+  std::shared_ptr<TimeProvider> time_provider_;
+  /// Heartbeat of every worker if watchdog is set.
+  std::vector<std::shared_ptr<TaskHeartbeat>> heartbeats_;
+  TaskLoopMetrics metrics_;
+
+  std::mutex delayed_guard_;
+  std::mutex task_quard_;
+
+  std::mutex idle_guard_;
+  std::condition_variable idle_event_;
+  /// Only one idle worker waits for next delayed task, others wait for ready
+  /// tasks.
+  std::shared_ptr<TaskPump> timer_pump_;
+  bool has_timer_owner_;
+  /// Idle workers notified but not left waiting yet.
+  std::size_t wake_ups_count_;
+  std::atomic<std::size_t> ready_tasks_count_;
+  std::atomic<std::size_t> idle_workers_count_;
+
+  std::atomic<std::size_t> next_worker_;
+  std::atomic<bool> is_running_;
+
+  /// Tasks in worker deques.
+  TaskCapacity capacity_;
+
+  std::mutex coalesced_guard_;
+  std::unordered_map<std::string, TaskHandle> coalesced_tasks_;
+};
+}  // namespace mk
\ No newline at end of file
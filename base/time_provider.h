@@ -16,6 +16,6 @@ class TimeProvider {
    *
    * @return Now timestamp.
    */
-  virtual TimestampMs Now() const = 0;
+  virtual TimestampNs Now() const = 0;
 };
 }  // namespace mk
\ No newline at end of file
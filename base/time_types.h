@@ -3,6 +3,12 @@
 #include <chrono>
 
 namespace mk {
+/// Steady clock time since its epoch.
+using TimestampNs = std::chrono::nanoseconds;
+using IntervalNs = TimestampNs;
+
+/// Coarse durations convert to nanosecond ones implicitly, so millisecond
+/// delays and periods may be passed everywhere.
 using TimestampMs = std::chrono::milliseconds;
 using IntervalMs = TimestampMs;
-}
\ No newline at end of file
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "time_types.h"
+
+namespace mk {
+/**
+ * @brief How repeating task counts its period.
+ *
+ */
+enum class RepeatMode {
+  kFixedDelay,  ///< Period starts when previous run finishes.
+  kFixedRate,   ///< Runs follow fixed schedule. Missed runs are skipped.
+};
+
+/**
+ * @brief Delayed and repeating task timing.
+ *
+ */
+struct TimerOptions {
+  RepeatMode repeat_mode{RepeatMode::kFixedDelay};
+
+  /// Task may run this much late, so nearby timers share one wakeup.
+  IntervalNs slack{0};
+};
+}  // namespace mk
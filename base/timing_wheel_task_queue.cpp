@@ -0,0 +1,276 @@
+#include "timing_wheel_task_queue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace mk {
+namespace {
+constexpr unsigned kTickShift = 12;
+
+TimestampNs FromTick(std::uint64_t tick) {
+  constexpr auto kMaxTick =
+      static_cast<std::uint64_t>(TimestampNs::max().count()) >> kTickShift;
+  return tick > kMaxTick
+             ? TimestampNs::max()
+             : TimestampNs{static_cast<TimestampNs::rep>(tick << kTickShift)};
+}
+
+// Time is rounded down, so wheel is never moved past now and bucket never
+// starts after its tasks.
+std::uint64_t ToTick(TimestampNs time) {
+  return static_cast<std::uint64_t>(
+             std::max<TimestampNs::rep>(time.count(), 0)) >>
+         kTickShift;
+}
+
+constexpr std::uint64_t SlotBit(std::size_t slot) {
+  return std::uint64_t{1} << (slot % 64);
+}
+}  // namespace
+
+TimingWheelTaskQueue::TimingWheelTaskQueue(
+    std::shared_ptr<TimeProvider> time_provider)
+    : time_provider_{std::move(time_provider)}, current_tick_{0}, size_{0} {
+  unsigned shift = 0;
+  for (std::size_t i = 0; i < kLevelsCount; ++i) {
+    auto& level = levels_[i];
+    level.shift = shift;
+    level.bits = i == 0 ? 8 : 6;
+    level.buckets.resize(std::size_t{1} << level.bits);
+
+    shift += level.bits;
+  }
+}
+
+void TimingWheelTaskQueue::AddTask(PendingTask* task) {
+  if (size_ == 0) {
+    // Empty wheel has no buckets to keep, so it skips idle period.
+    current_tick_ =
+        std::max(current_tick_, ToTick(time_provider_->Now()));
+  }
+
+  Insert(task);
+  ++size_;
+}
+
+PendingTask* TimingWheelTaskQueue::PopTask() {
+  assert(!IsEmpty() && "PopTask(). TimingWheelTaskQueue is empty.");
+
+  while (true) {
+    const auto position = FindFirstBucket();
+
+    if (position.level == kLevelsCount) {
+      RefillFromOverflow();
+      continue;
+    }
+
+    current_tick_ = GetBucketTick(position);
+
+    if (position.level != 0) {
+      // Move wheel to the bucket start and spread bucket tasks over lower
+      // levels.
+      Cascade(position);
+      continue;
+    }
+
+    auto* pending_task =
+        FindReadyTask(levels_.front().buckets[position.slot]);
+    RemoveFromBucket(position, pending_task);
+
+    --size_;
+    return pending_task;
+  }
+}
+
+void TimingWheelTaskQueue::RemoveTask(PendingTask* task) {
+  const auto position = Locate(GetTaskTick(*task));
+
+  if (position.level == kLevelsCount) {
+    overflow_.Remove(task);
+  } else {
+    RemoveFromBucket(position, task);
+  }
+
+  --size_;
+}
+
+bool TimingWheelTaskQueue::IsEmpty() const { return size_ == 0; }
+
+TimestampNs TimingWheelTaskQueue::GetNextTaskCallTime() const {
+  assert(!IsEmpty() &&
+         "GetNextTaskCallTime(). TimingWheelTaskQueue is empty.");
+
+  const auto position = FindFirstBucket();
+  if (position.level == kLevelsCount) {
+    return overflow_.GetTop()->next_call;
+  }
+
+  if (position.level != 0) {
+    const auto tick = GetBucketTick(position);
+    if (tick > ToTick(time_provider_->Now())) {
+      // Bucket is cascaded when now reaches it, its start is enough to wait.
+      return FromTick(tick);
+    }
+  }
+
+  return FindReadyTask(levels_[position.level].buckets[position.slot])
+      ->next_call;
+}
+
+void TimingWheelTaskQueue::LinkTask(Bucket& bucket, PendingTask* task) {
+  task->queue_prev = bucket.tail;
+  task->queue_next = nullptr;
+  // Bucket tasks are linked, queue_index only tells that task is queued.
+  task->queue_index = 0;
+
+  if (bucket.tail) {
+    bucket.tail->queue_next = task;
+  } else {
+    bucket.head = task;
+  }
+  bucket.tail = task;
+}
+
+void TimingWheelTaskQueue::UnlinkTask(Bucket& bucket, PendingTask* task) {
+  if (task->queue_prev) {
+    task->queue_prev->queue_next = task->queue_next;
+  } else {
+    bucket.head = task->queue_next;
+  }
+
+  if (task->queue_next) {
+    task->queue_next->queue_prev = task->queue_prev;
+  } else {
+    bucket.tail = task->queue_prev;
+  }
+
+  task->queue_prev = nullptr;
+  task->queue_next = nullptr;
+  task->queue_index = PendingTask::kNotQueued;
+}
+
+void TimingWheelTaskQueue::Insert(PendingTask* task) {
+  const auto position = Locate(GetTaskTick(*task));
+
+  if (position.level == kLevelsCount) {
+    overflow_.Push(task);
+    return;
+  }
+
+  auto& level = levels_[position.level];
+  LinkTask(level.buckets[position.slot], task);
+  level.occupied[position.slot / 64] |= SlotBit(position.slot);
+}
+
+void TimingWheelTaskQueue::Cascade(const Position& position) {
+  auto& level = levels_[position.level];
+  auto& bucket = level.buckets[position.slot];
+  auto* task = bucket.head;
+
+  bucket = Bucket{};
+  level.occupied[position.slot / 64] &= ~SlotBit(position.slot);
+
+  while (task) {
+    auto* next = task->queue_next;
+    Insert(task);
+    task = next;
+  }
+}
+
+void TimingWheelTaskQueue::RefillFromOverflow() {
+  // Move wheel to the earliest overflow task and take overflow tasks which
+  // fit into the wheel from there.
+  current_tick_ = GetTaskTick(*overflow_.GetTop());
+
+  while (!overflow_.IsEmpty()) {
+    auto* task = overflow_.GetTop();
+    if (Locate(GetTaskTick(*task)).level == kLevelsCount) {
+      break;
+    }
+
+    overflow_.Remove(task);
+    Insert(task);
+  }
+}
+
+void TimingWheelTaskQueue::RemoveFromBucket(const Position& position,
+                                            PendingTask* task) {
+  auto& level = levels_[position.level];
+  auto& bucket = level.buckets[position.slot];
+
+  assert(task->queue_index != PendingTask::kNotQueued &&
+         "RemoveTask(). Task is not in TimingWheelTaskQueue.");
+
+  UnlinkTask(bucket, task);
+  if (!bucket.head) {
+    level.occupied[position.slot / 64] &= ~SlotBit(position.slot);
+  }
+}
+
+TimingWheelTaskQueue::Position TimingWheelTaskQueue::Locate(
+    std::uint64_t tick) const {
+  for (std::size_t i = 0; i < kLevelsCount; ++i) {
+    const auto& level = levels_[i];
+    const auto epoch_shift = level.shift + level.bits;
+
+    if ((tick >> epoch_shift) == (current_tick_ >> epoch_shift)) {
+      return Position{i, static_cast<std::size_t>(
+                             (tick >> level.shift) &
+                             ((std::uint64_t{1} << level.bits) - 1))};
+    }
+  }
+
+  return Position{};
+}
+
+std::uint64_t TimingWheelTaskQueue::GetTaskTick(const PendingTask& task) const {
+  // Overdue task is expired together with current bucket.
+  return std::max(ToTick(task.next_call), current_tick_);
+}
+
+TimingWheelTaskQueue::Position TimingWheelTaskQueue::FindFirstBucket() const {
+  // Every level holds only tasks later than tasks of previous levels, and
+  // buckets of level never hold tasks earlier than current tick.
+  for (std::size_t i = 0; i < kLevelsCount; ++i) {
+    const auto& occupied = levels_[i].occupied;
+
+    for (std::size_t word = 0; word < occupied.size(); ++word) {
+      if (occupied[word] != 0) {
+        return Position{
+            i, word * 64 +
+                   static_cast<std::size_t>(__builtin_ctzll(occupied[word]))};
+      }
+    }
+  }
+
+  return Position{};
+}
+
+std::uint64_t TimingWheelTaskQueue::GetBucketTick(
+    const Position& position) const {
+  const auto& level = levels_[position.level];
+  const auto epoch_shift = level.shift + level.bits;
+
+  return ((current_tick_ >> epoch_shift) << epoch_shift) |
+         (static_cast<std::uint64_t>(position.slot) << level.shift);
+}
+
+PendingTask* TimingWheelTaskQueue::FindReadyTask(const Bucket& bucket) const {
+  // Any task which is due may go first, otherwise the earliest one does.
+  const auto now = time_provider_->Now();
+  PendingTask* earliest_task = nullptr;
+
+  for (auto* task = bucket.head; task; task = task->queue_next) {
+    if (task->next_call <= now) {
+      return task;
+    }
+
+    if (!earliest_task || task->next_call < earliest_task->next_call) {
+      earliest_task = task;
+    }
+  }
+
+  return earliest_task;
+}
+}  // namespace mk
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "task_heap.h"
+#include "task_queue.h"
+#include "time_provider.h"
+
+namespace mk {
+/**
+ * @brief Hierarchical timing wheel task queue.
+ *
+ * First level has 256 buckets of 2^12 ns (about 4 us). Every next level has
+ * 64 buckets each covering whole previous level. Every bucket is intrusive
+ * FIFO list, so task is added and removed in O(1). Tasks beyond last level
+ * wait in overflow heap. Tasks are cascaded to lower levels when wheel
+ * reaches their bucket.
+ *
+ * First level bucket reports call time of its due or earliest task, so tasks
+ * are never popped early and due tasks don't wait for tick end. Higher level
+ * bucket reports its start until now reaches it, so loop wakes up at most
+ * once per level on the way to a distant task. Due tasks of one tick may be
+ * popped out of call time order.
+ *
+ * Empty wheel is moved to now on next insert, so tasks don't wait in
+ * overflow list after idle periods.
+ *
+ */
+class TimingWheelTaskQueue : public TaskQueue {
+ public:
+  /**
+   * @param time_provider Source of now for empty wheel.
+   */
+  explicit TimingWheelTaskQueue(std::shared_ptr<TimeProvider> time_provider);
+
+  /** @see TaskQueue. */
+  void AddTask(PendingTask* task) override;
+
+  /** @see TaskQueue. */
+  PendingTask* PopTask() override;
+
+  /** @see TaskQueue. */
+  void RemoveTask(PendingTask* task) override;
+
+  /** @see TaskQueue. */
+  bool IsEmpty() const override;
+
+  /** @see TaskQueue. */
+  TimestampNs GetNextTaskCallTime() const override;
+
+ private:
+  static constexpr std::size_t kLevelsCount = 4;
+  static constexpr std::size_t kMaxSlotsCount = 256;
+
+  /**
+   * @brief Tasks with close call time in insertion order.
+   *
+   */
+  struct Bucket {
+    PendingTask* head{nullptr};
+    PendingTask* tail{nullptr};
+  };
+
+  /**
+   * @brief Wheel level.
+   *
+   */
+  struct Level {
+    unsigned shift{0};
+    unsigned bits{0};
+    std::vector<Bucket> buckets;
+    std::array<std::uint64_t, kMaxSlotsCount / 64> occupied{};
+  };
+
+  /**
+   * @brief Bucket position in the wheel.
+   *
+   */
+  struct Position {
+    std::size_t level{kLevelsCount};
+    std::size_t slot{0};
+  };
+
+  static void LinkTask(Bucket& bucket, PendingTask* task);
+  static void UnlinkTask(Bucket& bucket, PendingTask* task);
+
+  void Insert(PendingTask* task);
+  void Cascade(const Position& position);
+  void RefillFromOverflow();
+  void RemoveFromBucket(const Position& position, PendingTask* task);
+  Position Locate(std::uint64_t tick) const;
+  std::uint64_t GetTaskTick(const PendingTask& task) const;
+  Position FindFirstBucket() const;
+  std::uint64_t GetBucketTick(const Position& position) const;
+  PendingTask* FindReadyTask(const Bucket& bucket) const;
+
+  std::shared_ptr<TimeProvider> time_provider_;
+  std::array<Level, kLevelsCount> levels_;
+  TaskHeap overflow_;
+
+  std::uint64_t current_tick_;
+  std::size_t size_;
+};
+}  // namespace mk
\ No newline at end of file
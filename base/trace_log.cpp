@@ -0,0 +1,270 @@
+#include "trace_log.h"
+
+#if defined(MK_ENABLE_TRACING)
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+namespace mk {
+/**
+ * @brief Single writer ring buffer of trace events.
+ *
+ * Owner thread overwrites oldest events without locks. Reader validates
+ * every slot by its sequence number and skips slots overwritten during
+ * reading.
+ *
+ */
+class TraceBuffer {
+ public:
+  static constexpr std::size_t kCapacity = 4096;
+
+  explicit TraceBuffer(std::uint32_t thread_id)
+      : thread_id_{thread_id}, write_index_{0} {}
+
+  std::uint32_t GetThreadId() const { return thread_id_; }
+
+  /**
+   * @brief Write event. Must be called by owner thread only.
+   *
+   */
+  void Write(const TraceEvent& event) {
+    const auto index = write_index_.load(std::memory_order_relaxed);
+    auto& slot = slots_[index % kCapacity];
+
+    slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+
+    // Reader seeing any new field value sees odd sequence as well.
+    slot.phase.store(event.phase, std::memory_order_release);
+    slot.name.store(event.name, std::memory_order_release);
+    slot.file.store(event.location.file, std::memory_order_release);
+    slot.line.store(event.location.line, std::memory_order_release);
+    slot.timestamp.store(event.timestamp, std::memory_order_release);
+    slot.duration.store(event.duration, std::memory_order_release);
+    slot.flow_id.store(event.flow_id, std::memory_order_release);
+    slot.queue_time.store(event.queue_time, std::memory_order_release);
+
+    slot.sequence.store(index * 2 + 2, std::memory_order_release);
+    write_index_.store(index + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief Copy consistent events. May be called from any thread.
+   *
+   */
+  void Read(std::vector<TraceEvent>& events) const {
+    const auto end = write_index_.load(std::memory_order_acquire);
+    const auto begin = end > kCapacity ? end - kCapacity : 0;
+
+    for (auto index = begin; index < end; ++index) {
+      const auto& slot = slots_[index % kCapacity];
+      const auto sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence != index * 2 + 2) {
+        continue;
+      }
+
+      TraceEvent event;
+      event.phase = slot.phase.load(std::memory_order_acquire);
+      event.name = slot.name.load(std::memory_order_acquire);
+      event.location.file = slot.file.load(std::memory_order_acquire);
+      event.location.line = slot.line.load(std::memory_order_acquire);
+      event.timestamp = slot.timestamp.load(std::memory_order_acquire);
+      event.duration = slot.duration.load(std::memory_order_acquire);
+      event.flow_id = slot.flow_id.load(std::memory_order_acquire);
+      event.queue_time = slot.queue_time.load(std::memory_order_acquire);
+
+      if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+        events.push_back(event);
+      }
+    }
+  }
+
+ private:
+  /**
+   * @brief Event storage. Odd sequence means slot is being written.
+   *
+   */
+  struct Slot {
+    std::atomic<std::uint64_t> sequence{0};
+    std::atomic<char> phase{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<const char*> file{nullptr};
+    std::atomic<int> line{0};
+    std::atomic<std::uint64_t> timestamp{0};
+    std::atomic<std::uint64_t> duration{0};
+    std::atomic<std::uint64_t> flow_id{0};
+    std::atomic<std::uint64_t> queue_time{0};
+  };
+
+  const std::uint32_t thread_id_;
+  std::atomic<std::uint64_t> write_index_;
+  std::array<Slot, kCapacity> slots_;
+};
+
+namespace {
+thread_local TraceBuffer* current_buffer = nullptr;
+
+void WriteEscaped(std::ostream& stream, const char* string) {
+  for (; *string != '\0'; ++string) {
+    if (*string == '"' || *string == '\\') {
+      stream << '\\';
+    }
+    stream << *string;
+  }
+}
+
+void WriteName(std::ostream& stream, const TraceEvent& event) {
+  stream << '"';
+  if (event.name != nullptr) {
+    WriteEscaped(stream, event.name);
+  } else if (event.location.file != nullptr) {
+    WriteEscaped(stream, event.location.file);
+    stream << ':' << event.location.line;
+  } else {
+    stream << "unknown";
+  }
+  stream << '"';
+}
+
+void WriteMicroseconds(std::ostream& stream, std::uint64_t nanoseconds) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%llu.%03llu",
+                static_cast<unsigned long long>(nanoseconds / 1000),
+                static_cast<unsigned long long>(nanoseconds % 1000));
+  stream << buffer;
+}
+}  // namespace
+
+TraceLog& TraceLog::Get() {
+  static TraceLog trace_log;
+  return trace_log;
+}
+
+std::uint64_t TraceLog::Now() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+TraceLog::TraceLog() : last_flow_id_{0} {}
+
+TraceLog::~TraceLog() = default;
+
+std::uint64_t TraceLog::MakeFlowId() { return ++last_flow_id_; }
+
+void TraceLog::AddEvent(const TraceEvent& event) {
+  GetThreadBuffer().Write(event);
+}
+
+void TraceLog::WriteJson(std::ostream& stream) {
+  stream << "{\"traceEvents\":[";
+
+  bool is_first = true;
+  std::vector<TraceEvent> events;
+
+  std::lock_guard lock{guard_};
+  for (const auto& buffer : buffers_) {
+    events.clear();
+    buffer->Read(events);
+
+    for (const auto& event : events) {
+      stream << (is_first ? "\n" : ",\n");
+      is_first = false;
+
+      stream << "{\"name\":";
+      WriteName(stream, event);
+      stream << ",\"cat\":\"task\",\"ph\":\"" << event.phase
+             << "\",\"pid\":1,\"tid\":" << buffer->GetThreadId()
+             << ",\"ts\":";
+      WriteMicroseconds(stream, event.timestamp);
+
+      if (event.phase == 'X') {
+        stream << ",\"dur\":";
+        WriteMicroseconds(stream, event.duration);
+        stream << ",\"args\":{\"queue_us\":";
+        WriteMicroseconds(stream, event.queue_time);
+        stream << "}";
+      } else {
+        stream << ",\"id\":" << event.flow_id;
+        if (event.phase == 'f') {
+          // Bind flow end to the enclosing task slice.
+          stream << ",\"bp\":\"e\"";
+        }
+      }
+
+      stream << "}";
+    }
+  }
+
+  stream << "\n]}\n";
+}
+
+TraceBuffer& TraceLog::GetThreadBuffer() {
+  if (current_buffer == nullptr) {
+    std::lock_guard lock{guard_};
+    buffers_.push_back(std::make_unique<TraceBuffer>(
+        static_cast<std::uint32_t>(buffers_.size() + 1)));
+    current_buffer = buffers_.back().get();
+  }
+
+  return *current_buffer;
+}
+
+void TraceTaskPosted(PendingTask& pending_task) {
+  auto& trace_log = TraceLog::Get();
+
+  auto& trace = pending_task.trace;
+  trace.posted_from = pending_task.task.GetLocation();
+  trace.flow_id = trace_log.MakeFlowId();
+  trace.post_time = TraceLog::Now();
+
+  TraceEvent event;
+  event.phase = 's';
+  event.name = "PostTask";
+  event.timestamp = trace.post_time;
+  event.flow_id = trace.flow_id;
+  trace_log.AddEvent(event);
+}
+
+ScopedTaskTrace::ScopedTaskTrace(PendingTask& pending_task)
+    : location_{pending_task.trace.posted_from},
+      start_time_{TraceLog::Now()},
+      queue_time_{0} {
+  auto& trace = pending_task.trace;
+  if (trace.flow_id == 0) {
+    // Next run of repeating task.
+    return;
+  }
+
+  queue_time_ = start_time_ - trace.post_time;
+
+  TraceEvent event;
+  event.phase = 'f';
+  event.name = "PostTask";
+  event.timestamp = start_time_;
+  event.flow_id = std::exchange(trace.flow_id, 0);
+  TraceLog::Get().AddEvent(event);
+}
+
+ScopedTaskTrace::~ScopedTaskTrace() {
+  TraceEvent event;
+  event.location = location_;
+  event.timestamp = start_time_;
+  event.duration = TraceLog::Now() - start_time_;
+  event.queue_time = queue_time_;
+  TraceLog::Get().AddEvent(event);
+}
+
+ScopedTraceEvent::ScopedTraceEvent(const char* name)
+    : name_{name}, start_time_{TraceLog::Now()} {}
+
+ScopedTraceEvent::~ScopedTraceEvent() {
+  TraceEvent event;
+  event.name = name_;
+  event.timestamp = start_time_;
+  event.duration = TraceLog::Now() - start_time_;
+  TraceLog::Get().AddEvent(event);
+}
+}  // namespace mk
+#endif
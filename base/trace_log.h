@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "pending_task.h"
+
+namespace mk {
+#if defined(MK_ENABLE_TRACING)
+/**
+ * @brief Trace event in Chrome trace event format terms.
+ *
+ */
+struct TraceEvent {
+  char phase{'X'};              ///< 'X' slice, 's' flow start, 'f' flow end.
+  const char* name{nullptr};    ///< Static string. Location is used if null.
+  Location location;            ///< Task posting location.
+  std::uint64_t timestamp{0};   ///< Trace clock nanoseconds.
+  std::uint64_t duration{0};    ///< Slice duration in nanoseconds.
+  std::uint64_t flow_id{0};     ///< Flow id of 's' and 'f' events.
+  std::uint64_t queue_time{0};  ///< Nanoseconds task waited before start.
+};
+
+class TraceBuffer;
+
+/**
+ * @brief Collects trace events of all threads.
+ *
+ * Every thread writes to its own lock-free ring buffer, which keeps last
+ * events only. Events can be dumped at any time as Chrome trace event JSON,
+ * which opens in Perfetto and chrome://tracing.
+ *
+ */
+class TraceLog {
+ public:
+  static TraceLog& Get();
+
+  /**
+   * @brief Trace clock.
+   *
+   * @return Steady clock nanoseconds.
+   */
+  static std::uint64_t Now();
+
+  /**
+   * @brief Generate unique flow id.
+   *
+   */
+  std::uint64_t MakeFlowId();
+
+  /**
+   * @brief Add event to calling thread buffer.
+   *
+   * @param event Event to be added.
+   */
+  void AddEvent(const TraceEvent& event);
+
+  /**
+   * @brief Write all buffered events as Chrome trace event JSON.
+   *
+   * @param stream Output stream.
+   */
+  void WriteJson(std::ostream& stream);
+
+ private:
+  TraceLog();
+  ~TraceLog();
+
+  TraceBuffer& GetThreadBuffer();
+
+  std::mutex guard_;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+  std::atomic<std::uint64_t> last_flow_id_;
+};
+
+/**
+ * @brief Record task posting and start flow to task run.
+ *
+ * @param pending_task Task just acquired from pool.
+ */
+void TraceTaskPosted(PendingTask& pending_task);
+
+/**
+ * @brief Record task run as slice which ends the posting flow.
+ *
+ */
+class ScopedTaskTrace {
+ public:
+  explicit ScopedTaskTrace(PendingTask& pending_task);
+  ~ScopedTaskTrace();
+
+  ScopedTaskTrace(const ScopedTaskTrace&) = delete;
+  ScopedTaskTrace& operator=(const ScopedTaskTrace&) = delete;
+
+ private:
+  Location location_;
+  std::uint64_t start_time_;
+  std::uint64_t queue_time_;
+};
+
+/**
+ * @brief Record named slice.
+ *
+ */
+class ScopedTraceEvent {
+ public:
+  explicit ScopedTraceEvent(const char* name);
+  ~ScopedTraceEvent();
+
+  ScopedTraceEvent(const ScopedTraceEvent&) = delete;
+  ScopedTraceEvent& operator=(const ScopedTraceEvent&) = delete;
+
+ private:
+  const char* name_;
+  std::uint64_t start_time_;
+};
+#else
+inline void TraceTaskPosted(PendingTask&) {}
+
+class ScopedTaskTrace {
+ public:
+  explicit ScopedTaskTrace(PendingTask&) {}
+};
+
+class ScopedTraceEvent {
+ public:
+  explicit ScopedTraceEvent(const char*) {}
+};
+#endif
+}  // namespace mk
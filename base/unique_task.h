@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "location.h"
+
+namespace mk {
+/**
+ * @brief Move-only callable wrapper with small buffer optimization.
+ *
+ * Callable is stored inline if it fits kInlineSize and it is nothrow move
+ * constructible. Otherwise callable is allocated on heap. Unlike
+ * std::function captured state is never copied and may be move-only
+ * (std::unique_ptr, pixel buffers, etc).
+ *
+ * Task remembers where callable has been converted to task, that is
+ * PostTask() call site in most cases. Tracing and watchdog report it.
+ *
+ */
+class UniqueTask {
+ public:
+  static constexpr std::size_t kInlineSize = 96;
+
+  UniqueTask() noexcept = default;
+
+  UniqueTask(std::nullptr_t) noexcept {}
+
+  template <typename Callable,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::decay_t<Callable>, UniqueTask> &&
+                std::is_invocable_r_v<void, std::decay_t<Callable>&>>>
+  UniqueTask(Callable&& callable, Location location = Location::Current())
+      : location_{location} {
+    using Stored = std::decay_t<Callable>;
+
+    if constexpr (IsInline<Stored>()) {
+      new (&storage_) Stored(std::forward<Callable>(callable));
+      operations_ = &kInlineOperations<Stored>;
+    } else {
+      new (&storage_) Stored*(new Stored(std::forward<Callable>(callable)));
+      operations_ = &kHeapOperations<Stored>;
+    }
+  }
+
+  UniqueTask(UniqueTask&& other) noexcept { MoveFrom(other); }
+
+  UniqueTask& operator=(UniqueTask&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+
+    return *this;
+  }
+
+  UniqueTask& operator=(std::nullptr_t) noexcept {
+    Reset();
+    return *this;
+  }
+
+  UniqueTask(const UniqueTask&) = delete;
+  UniqueTask& operator=(const UniqueTask&) = delete;
+
+  ~UniqueTask() { Reset(); }
+
+  /**
+   * @brief Call stored callable. Must not be called on empty task.
+   *
+   */
+  void operator()() { operations_->invoke(&storage_); }
+
+  explicit operator bool() const noexcept { return operations_ != nullptr; }
+
+  /**
+   * @brief Get location task has been created at.
+   *
+   */
+  const Location& GetLocation() const noexcept { return location_; }
+
+ private:
+  /**
+   * @brief Type erased callable operations.
+   *
+   */
+  struct Operations {
+    void (*invoke)(void* storage);
+    void (*move)(void* from, void* to) noexcept;
+    void (*destroy)(void* storage) noexcept;
+  };
+
+  template <typename Stored>
+  static constexpr bool IsInline() {
+    return sizeof(Stored) <= kInlineSize &&
+           alignof(Stored) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible_v<Stored>;
+  }
+
+  template <typename Stored>
+  static constexpr Operations kInlineOperations{
+      [](void* storage) { (*static_cast<Stored*>(storage))(); },
+      [](void* from, void* to) noexcept {
+        auto* callable = static_cast<Stored*>(from);
+        new (to) Stored(std::move(*callable));
+        callable->~Stored();
+      },
+      [](void* storage) noexcept { static_cast<Stored*>(storage)->~Stored(); }};
+
+  template <typename Stored>
+  static constexpr Operations kHeapOperations{
+      [](void* storage) { (**static_cast<Stored**>(storage))(); },
+      [](void* from, void* to) noexcept {
+        new (to) Stored*(*static_cast<Stored**>(from));
+      },
+      [](void* storage) noexcept { delete *static_cast<Stored**>(storage); }};
+
+  void MoveFrom(UniqueTask& other) noexcept {
+    if (other.operations_) {
+      other.operations_->move(&other.storage_, &storage_);
+      operations_ = std::exchange(other.operations_, nullptr);
+    }
+
+    location_ = other.location_;
+  }
+
+  void Reset() noexcept {
+    if (operations_) {
+      std::exchange(operations_, nullptr)->destroy(&storage_);
+    }
+  }
+
+  alignas(std::max_align_t) std::byte storage_[kInlineSize];
+  const Operations* operations_{nullptr};
+  Location location_;
+};
+}  // namespace mk
\ No newline at end of file
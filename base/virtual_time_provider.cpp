@@ -0,0 +1,21 @@
+#include "virtual_time_provider.h"
+
+namespace mk {
+VirtualTimeProvider::VirtualTimeProvider()
+    : VirtualTimeProvider(TimestampNs{0}) {}
+
+VirtualTimeProvider::VirtualTimeProvider(TimestampNs start_time)
+    : now_{start_time} {}
+
+TimestampNs VirtualTimeProvider::Now() const { return now_; }
+
+void VirtualTimeProvider::Advance(IntervalNs interval) {
+  AdvanceTo(Now() + interval);
+}
+
+void VirtualTimeProvider::AdvanceTo(TimestampNs time) {
+  auto now = now_.load();
+  while (now < time && !now_.compare_exchange_weak(now, time)) {
+  }
+}
+}  // namespace mk
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+
+#include "time_provider.h"
+
+namespace mk {
+/**
+ * @brief Time which moves only when it is advanced.
+ *
+ * Paired with TaskPumpVirtual it lets loop fast-forward through delayed and
+ * repeating tasks, so timings are exact and reproducible. RunLoop takes the
+ * pump as its pump and ThreadPoolRunLoop as its timer pump. RunLoopUi waits
+ * by backend waiter, which should advance the provider instead.
+ *
+ */
+class VirtualTimeProvider : public TimeProvider {
+ public:
+  VirtualTimeProvider();
+  explicit VirtualTimeProvider(TimestampNs start_time);
+
+  /** @see TimeProvider. */
+  TimestampNs Now() const override;
+
+  /**
+   * @brief Move time forward.
+   *
+   * @param interval Non-negative interval.
+   */
+  void Advance(IntervalNs interval);
+
+  /**
+   * @brief Move time forward to given time. Earlier time is ignored.
+   *
+   * @param time New time.
+   */
+  void AdvanceTo(TimestampNs time);
+
+ private:
+  std::atomic<TimestampNs> now_;
+};
+}  // namespace mk
@@ -5,4 +5,5 @@ inline auto UiRunLoop = [] {};
 inline auto UiDispathTask = [] {};
 inline auto FilesystemRunLoop = [] {};
 inline auto FilesystemDispatchTask = [] {};
+inline auto FilesystemThread = [] {};
 }  // namespace mk::di_names
\ No newline at end of file
@@ -3,34 +3,55 @@
 #include <imgui.h>
 #include <stb_image.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 
+#include "base/bind_weak.h"
 #include "base/dispatch_task.h"
+#include "base/file_load_pipeline.h"
+#include "base/future.h"
+#include "base/metrics.h"
 
 namespace mk {
+namespace {
+Histogram& GetDecodeTimeHistogram() {
+  static auto& histogram = MetricsRegistry::Get().GetHistogram(
+      "mk_image_decode_microseconds", "Image file decoding time.");
+  return histogram;
+}
+
+Gauge& GetTextureBytesGauge() {
+  static auto& gauge = MetricsRegistry::Get().GetGauge(
+      "mk_texture_resident_bytes", "Image pixels uploaded to GPU.");
+  return gauge;
+}
+}  // namespace
 
 Image::Image(std::filesystem::path image_path,
              std::shared_ptr<DispatchTask> ui_task_dispatcher,
-             std::shared_ptr<DispatchTask> filesystem_task_dispatcher)
+             std::shared_ptr<FileLoadPipeline> file_load_pipeline)
     : ui_task_dispatcher_{std::move(ui_task_dispatcher)},
-      filesystem_task_dispatcher_{std::move(filesystem_task_dispatcher)},
+      file_load_pipeline_{std::move(file_load_pipeline)},
       image_path_{std::move(image_path)},
       status_{ReadyStatus::kNone},
+      image_reading_priority_{TaskPriority::kBackground},
       width_{0},
       height_{0} {}
 
 Image::~Image() {
-  if (image_reading_task_handle_) {
-    filesystem_task_dispatcher_->CancelTask(
-        std::move(image_reading_task_handle_));
-    image_reading_task_handle_ = TaskHandle{nullptr};
+  if (image_loading_handle_.IsIssued()) {
+    file_load_pipeline_->CancelLoad(std::move(image_loading_handle_));
+    image_loading_handle_ = TaskHandle{};
   }
 
   if (image_texture_id_) {
     GLuint texture_id = image_texture_id_.value();
     image_texture_id_.reset();
     glDeleteTextures(1, &texture_id);
+    GetTextureBytesGauge().Add(
+        -static_cast<std::int64_t>(texture_.image_data.size()));
   }
 }
 
@@ -43,14 +64,22 @@ void Image::Display() {
       break;
 
     case ReadyStatus::kReading:
-      if (progress_callback_) {
-        progress_callback_();
+      DisplayPlaceholder();
+      if (const auto priority = GetReadingPriority();
+          priority != image_reading_priority_) {
+        // Image has been scrolled into or out of view while it waits in
+        // pipeline.
+        image_reading_priority_ = priority;
+        file_load_pipeline_->UpdateLoadPriority(image_loading_handle_,
+                                                image_reading_priority_);
       }
       break;
 
     case ReadyStatus::kNone:
       status_ = ReadyStatus::kReading;
-      image_reading_task_handle_ = LoadImageFromFileOnFilesystemThread();
+      DisplayPlaceholder();
+      image_reading_priority_ = GetReadingPriority();
+      LoadImageFile();
       break;
 
     case ReadyStatus::kReady:
@@ -84,32 +113,76 @@ void Image::SetProgressHandler(std::function<void()> handler) {
   progress_callback_ = handler;
 }
 
-TaskHandle Image::LoadImageFromFileOnFilesystemThread() {
-  return filesystem_task_dispatcher_->PostTask([lifetime_controller =
-                                                    shared_from_this()]() {
-    // Filesystem thread.
-    auto texture = lifetime_controller->LoadImageDataFromFile(
-        lifetime_controller->image_path_);
-
-    if (texture.has_value()) {
-      lifetime_controller->ui_task_dispatcher_->PostTask(
-          [texture_image = std::move(texture.value()), lifetime_controller]() {
-            // UI thread.
-            lifetime_controller->OnTextureReadingSuccess(
-                std::move(texture_image));
-          });
-    } else {
-      lifetime_controller->ui_task_dispatcher_->PostTask(
-          [lifetime_controller]() {
-            // UI thread.
-            lifetime_controller->OnError();
-          });
-    }
-  });
+void Image::DisplayPlaceholder() {
+  // Texture size is unknown until image is decoded, then placeholder is one
+  // line of progress.
+  const ImVec2 size(
+      width_ == 0 ? ImGui::GetContentRegionAvail().x
+                  : static_cast<float>(width_),
+      height_ == 0 ? ImGui::GetTextLineHeight() : static_cast<float>(height_));
+  const auto start = ImGui::GetCursorScreenPos();
+
+  ImGui::BeginGroup();
+  if (progress_callback_) {
+    progress_callback_();
+  }
+
+  // Pad group up to image size, so images below keep their place.
+  const auto end = ImGui::GetCursorScreenPos();
+  ImGui::Dummy(ImVec2(size.x, std::max(start.y + size.y - end.y, 0.0f)));
+  ImGui::EndGroup();
+}
+
+TaskPriority Image::GetReadingPriority() const {
+  return ImGui::IsItemVisible() ? TaskPriority::kUserBlocking
+                                : TaskPriority::kBackground;
+}
+
+void Image::LoadImageFile() {
+  // Cancelled load drops promise, so reply is never posted.
+  Promise<tl::expected<ImageTexture, std::error_code>> texture_promise;
+  texture_promise.GetFuture().Then(
+      ui_task_dispatcher_,
+      BindWeak(weak_from_this(),
+               [](Image& image, auto texture) {
+                 // UI thread.
+                 if (texture.has_value()) {
+                   image.OnTextureReadingSuccess(std::move(texture.value()));
+                 } else {
+                   image.OnError();
+                 }
+               }),
+      image_reading_priority_);
+
+  image_loading_handle_ = file_load_pipeline_->Load(
+      image_path_,
+      [texture_promise](std::error_code error,
+                        std::vector<std::byte> file_data) mutable {
+        // Filesystem thread.
+        texture_promise.SetValue(DecodeImageFile(error, file_data));
+      },
+      image_reading_priority_);
+}
+
+tl::expected<Image::ImageTexture, std::error_code> Image::DecodeImageFile(
+    std::error_code error, const std::vector<std::byte>& file_data) {
+  if (error) {
+    fprintf(stderr, "Failed to read image: %s\n", error.message().c_str());
+    return tl::unexpected{error};
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  auto texture = DecodeImageData(file_data);
+  GetDecodeTimeHistogram().Record(static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count()));
+
+  return texture;
 }
 
-tl::expected<Image::ImageTexture, std::error_code> Image::LoadImageDataFromFile(
-    std::filesystem::path image_path) {
+tl::expected<Image::ImageTexture, std::error_code> Image::DecodeImageData(
+    const std::vector<std::byte>& file_data) {
   //  TODO(BoSv): Adapt image resizing.
   // if (!IsPowerOfTwo(width) || !IsPowerOfTwo(height)) {
   // 	//std::cout << "size is not power of two! resizing... ";
@@ -132,8 +205,9 @@ tl::expected<Image::ImageTexture, std::error_code> Image::LoadImageDataFromFile(
   int x = 0;
   int y = 0;
   int channels = 0;
-  unsigned char* image_data =
-      stbi_load(image_path.c_str(), &x, &y, &channels, 0);
+  unsigned char* image_data = stbi_load_from_memory(
+      reinterpret_cast<const stbi_uc*>(file_data.data()),
+      static_cast<int>(file_data.size()), &x, &y, &channels, 0);
 
   if (image_data == nullptr) {
     fprintf(stderr, "Failed to load image: %s\n", stbi_failure_reason());
@@ -179,6 +253,8 @@ intptr_t Image::GenerateImageOpenGlTexture() {
   glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format), texture_.width,
                texture_.height, 0, format, GL_UNSIGNED_BYTE,
                texture_.image_data.data());
+  GetTextureBytesGauge().Add(
+      static_cast<std::int64_t>(texture_.image_data.size()));
 
   return image_texture;
 }
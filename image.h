@@ -10,16 +10,18 @@
 #include <vector>
 
 #include "base/task_handle.h"
+#include "base/task_priority.h"
 #include "image_view.h"
 
 namespace mk {
 class DispatchTask;
+class FileLoadPipeline;
 
 class Image : public ImageView, public std::enable_shared_from_this<Image> {
  public:
   Image(std::filesystem::path image_path,
         std::shared_ptr<DispatchTask> ui_task_dispatcher,
-        std::shared_ptr<DispatchTask> filesystem_task_dispatcher);
+        std::shared_ptr<FileLoadPipeline> file_load_pipeline);
 
   ~Image() override;
 
@@ -43,7 +45,7 @@ class Image : public ImageView, public std::enable_shared_from_this<Image> {
    */
   enum class ReadyStatus {
     kNone,     ///< Initialialization state.
-    kReading,  ///< Image data is reading from file.
+    kReading,  ///< Image file is reading or decoding.
     kError,    ///< Image reading has failed.
     kReady,    ///< Image is ready to display.
   };
@@ -60,20 +62,44 @@ class Image : public ImageView, public std::enable_shared_from_this<Image> {
   };
 
   /**
-   * @brief Load image data from file on filesystem thread.
+   * @brief Read and decode image file in file load pipeline. Result is
+   * delivered on UI thread.
    *
-   * @return TaskHandle Filesystem thread task handle.
    */
-  TaskHandle LoadImageFromFileOnFilesystemThread();
+  void LoadImageFile();
 
   /**
-   * @brief Load image data from file.
+   * @brief Display progress in place of image which is being loaded.
    *
-   * @param image_path Absoluth path to file.
+   */
+  void DisplayPlaceholder();
+
+  /**
+   * @brief Choose image reading priority by placeholder visibility. Must be
+   * called right after DisplayPlaceholder().
+   *
+   * @return kUserBlocking if image is on screen. Otherwise kBackground.
+   */
+  TaskPriority GetReadingPriority() const;
+
+  /**
+   * @brief Decode read image file and record decoding time.
+   *
+   * @param error File read error.
+   * @param file_data Image file content.
+   * @return ImageTexture in success. Otherwise error code.
+   */
+  static tl::expected<ImageTexture, std::error_code> DecodeImageFile(
+      std::error_code error, const std::vector<std::byte>& file_data);
+
+  /**
+   * @brief Decode image data from memory.
+   *
+   * @param file_data Image file content.
    * @return ImageTexture in success. Otherwise error code.
    */
-  tl::expected<ImageTexture, std::error_code> LoadImageDataFromFile(
-      std::filesystem::path image_path);
+  static tl::expected<ImageTexture, std::error_code> DecodeImageData(
+      const std::vector<std::byte>& file_data);
 
   /**
    * @brief Generate texture and push image data to GPU.
@@ -87,11 +113,12 @@ class Image : public ImageView, public std::enable_shared_from_this<Image> {
   void OnError();
 
   std::shared_ptr<DispatchTask> ui_task_dispatcher_;
-  std::shared_ptr<DispatchTask> filesystem_task_dispatcher_;
+  std::shared_ptr<FileLoadPipeline> file_load_pipeline_;
   std::filesystem::path image_path_;
 
   ReadyStatus status_;
-  TaskHandle image_reading_task_handle_;
+  TaskHandle image_loading_handle_;
+  TaskPriority image_reading_priority_;
 
   ImageTexture texture_;
   std::optional<intptr_t> image_texture_id_;
@@ -1,38 +1,117 @@
 #include <boost/di.hpp>
+#include <fstream>
 #include <memory>
+#include <thread>
 
 #include "base/dispatch_task.h"
-#include "base/priority_task_queue.h"
-#include "base/run_loop.h"
+#include "base/file_load_pipeline.h"
+#if defined(__linux__)
+#include "base/file_reader_io_uring.h"
+#else
+#include "base/file_reader_blocking.h"
+#endif
+#include "base/metrics_file_exporter.h"
 #include "base/run_loop_backend_executor.h"
 #include "base/run_loop_ui.h"
 #include "base/steady_time_provider.h"
+#include "base/task_watchdog.h"
+#if defined(__linux__)
+#include "base/task_pump_epoll.h"
+#else
 #include "base/task_pump_std.h"
+#endif
+#include "base/thread_options.h"
+#include "base/thread_pool_run_loop.h"
+#include "base/timing_wheel_task_queue.h"
+#include "base/trace_log.h"
 #include "di_names.h"
 #include "filesystem_browser.h"
 #include "filesystem_browser_view.h"
 #include "mocker.h"
 #include "ui_application.h"
 
+namespace boost::di {
+// Components of base/ do not depend on boost.di, so their filesystem
+// dispatcher is named here.
+#if defined(__linux__)
+template <>
+struct ctor_traits<mk::FileReaderIoUring> {
+  BOOST_DI_INJECT_TRAITS((named = mk::di_names::FilesystemDispatchTask)
+                             std::shared_ptr<mk::DispatchTask>,
+                         std::shared_ptr<mk::TaskPumpEpoll>);
+};
+#else
+template <>
+struct ctor_traits<mk::FileReaderBlocking> {
+  BOOST_DI_INJECT_TRAITS((named = mk::di_names::FilesystemDispatchTask)
+                             std::shared_ptr<mk::DispatchTask>);
+};
+#endif
+
+template <>
+struct ctor_traits<mk::FileLoadPipeline> {
+  BOOST_DI_INJECT_TRAITS(mk::FileLoadPipelineOptions,
+                         std::shared_ptr<mk::FileReader>,
+                         (named = mk::di_names::FilesystemDispatchTask)
+                             std::shared_ptr<mk::DispatchTask>);
+};
+}  // namespace boost::di
+
 int main(int, char**) {
   using namespace mk;
   using namespace boost;
 
+  // Background reading and decoding yields CPU to UI thread. Set
+  // cpu_affinity to keep it off cores used by UI thread and compositor.
+  ThreadOptions filesystem_thread_options;
+  filesystem_thread_options.name = "filesystem";
+  filesystem_thread_options.scheduling_policy = ThreadSchedulingPolicy::kBatch;
+  filesystem_thread_options.priority = 5;
+
+  // Idle filesystem worker waits in the pump. On Linux it also handles
+  // io_uring completions there.
   const auto injector = di::make_injector(
+#if defined(__linux__)
+      di::bind<TaskPump, TaskPumpEpoll>.to<TaskPumpEpoll>(),
+#else
       di::bind<TaskPump>.to<TaskPumpStd>(),
-      di::bind<TaskQueue>.to<PriorityTaskQueue>(),
+#endif
+      di::bind<TaskQueue>.to<TimingWheelTaskQueue>(),
       di::bind<TimeProvider>.to<SteadyTimeProvider>(),
+      di::bind<RunLoopUiOptions>().to(RunLoopUiOptions{IntervalMs{8}}),
+      di::bind<TaskWatchdogOptions>().to(TaskWatchdogOptions{}),
+      di::bind<MetricsFileExporterOptions>().to(MetricsFileExporterOptions{}),
+      di::bind<FileLoadPipelineOptions>().to(FileLoadPipelineOptions{}),
       di::bind<TaskLoop>().named(di_names::UiRunLoop).to<RunLoopUi>(),
       di::bind<DispatchTask>().named(di_names::UiDispathTask).to<RunLoopUi>(),
-      di::bind<TaskLoop>().named(di_names::FilesystemRunLoop).to<RunLoop>(),
+      di::bind<ThreadOptions>()
+          .named(di_names::FilesystemThread)
+          .to(filesystem_thread_options),
+      di::bind<ThreadPoolOptions>().to(ThreadPoolOptions{
+          std::thread::hardware_concurrency(), filesystem_thread_options}),
+      di::bind<TaskLoop>()
+          .named(di_names::FilesystemRunLoop)
+          .to<ThreadPoolRunLoop>(),
       di::bind<DispatchTask>()
           .named(di_names::FilesystemDispatchTask)
-          .to<RunLoop>(),
+          .to<ThreadPoolRunLoop>(),
+#if defined(__linux__)
+      di::bind<FileReader>.to<FileReaderIoUring>(),
+#else
+      di::bind<FileReader>.to<FileReaderBlocking>(),
+#endif
       di::bind<RunLoopBackendExecutor>.to<RunLoopUi>(),
       di::bind<FilesystemReader, FilesystemBrowserView>.to<FilesystemBrowser>(),
       di::bind<UiApplication>.to<Mocker>());
 
   auto mocker = injector.create<std::shared_ptr<UiApplication>>();
   mocker->Run();
+
+#if defined(MK_ENABLE_TRACING)
+  // Open in https://ui.perfetto.dev or chrome://tracing.
+  std::ofstream trace_file{"mocker_trace.json"};
+  TraceLog::Get().WriteJson(trace_file);
+#endif
+
   return 0;
 }
\ No newline at end of file
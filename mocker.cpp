@@ -3,8 +3,9 @@
 #include <SDL3/SDL.h>
 #include <stdio.h>
 
+#include <algorithm>
 #include <iostream>
-#include <thread>
+#include <limits>
 
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
@@ -16,7 +17,11 @@
 #endif
 
 #include "base/dispatch_task.h"
+#include "base/metrics.h"
+#include "base/task_group.h"
 #include "base/task_loop.h"
+#include "base/task_watchdog.h"
+#include "base/thread.h"
 #include "filesystem_browser_view.h"
 #include "filesystem_reader.h"
 #include "image.h"
@@ -24,39 +29,63 @@
 namespace mk {
 namespace {
 constexpr std::string_view kOpenImagesPopup = "Open images?";
+constexpr int kSettleFramesCount = 3;
 }  // namespace
 
 Mocker::Mocker(std::shared_ptr<TaskLoop> ui_task_loop,
                std::shared_ptr<DispatchTask> ui_task_dispatcher,
                std::shared_ptr<TaskLoop> filesystem_task_loop,
                std::shared_ptr<DispatchTask> filesystem_task_dispatcher,
+               ThreadOptions filesystem_thread_options,
                std::shared_ptr<RunLoopBackendExecutor> ui_backend_executor,
-               std::shared_ptr<FilesystemBrowserView> filesystem_browser)
+               std::shared_ptr<FilesystemBrowserView> filesystem_browser,
+               std::shared_ptr<TaskWatchdog> watchdog,
+               MetricsFileExporterOptions metrics_exporter_options,
+               std::shared_ptr<FileLoadPipeline> file_load_pipeline)
     : ui_task_loop_{std::move(ui_task_loop)},
       filesystem_task_loop_{std::move(filesystem_task_loop)},
       filesystem_task_dispatcher_{std::move(filesystem_task_dispatcher)},
+      filesystem_thread_options_{std::move(filesystem_thread_options)},
       ui_task_dispatcher_{std::move(ui_task_dispatcher)},
+      file_load_pipeline_{std::move(file_load_pipeline)},
       ui_backend_executor_{std::move(ui_backend_executor)},
       filesystem_browser_{std::move(filesystem_browser)},
+      watchdog_{std::move(watchdog)},
+      metrics_exporter_options_{std::move(metrics_exporter_options)},
       gl_context_{nullptr},
       window_{nullptr},
-      show_demo_window_{true} {}
+      show_demo_window_{true},
+      wake_up_event_type_{0},
+      redraw_frames_count_{kSettleFramesCount},
+      is_animating_{false} {}
 
 UiApplication::Status Mocker::Run() {
   if (const auto status = Initialize(); status != UiApplication::Status::Ok) {
     return status;
   }
 
-  std::thread filesystem_thread([this]() {
+  ui_task_loop_->SetWatchdog(*watchdog_, "ui");
+  filesystem_task_loop_->SetWatchdog(*watchdog_, "filesystem");
+
+  auto& metrics = MetricsRegistry::Get();
+  ui_task_loop_->SetMetrics(metrics, "ui");
+  filesystem_task_loop_->SetMetrics(metrics, "filesystem");
+  MetricsFileExporter metrics_exporter{metrics, metrics_exporter_options_,
+                                       filesystem_task_dispatcher_};
+
+  Thread filesystem_thread{filesystem_thread_options_, [this]() {
     std::cout << "Run filesystem run loop." << std::endl;
     filesystem_task_loop_->Run();
-  });
+  }};
 
   ui_backend_executor_->SetBackendTask([this]() { return DrawUi(); });
+  ui_backend_executor_->SetBackendWaiter(
+      [this](IntervalNs timeout) { WaitForEvent(timeout); },
+      [this]() { WakeUp(); });
   ui_task_loop_->Run();
 
   filesystem_task_loop_->Stop();
-  filesystem_thread.join();
+  filesystem_thread.Join();
 
   // Cleanup
   ImGui_ImplOpenGL3_Shutdown();
@@ -106,6 +135,9 @@ UiApplication::Status Mocker::Initialize() {
   // Enable native IME.
   SDL_SetHint(SDL_HINT_IME_SHOW_UI, "1");
 
+  // Wakes idle UI loop when task is posted from another thread.
+  wake_up_event_type_ = SDL_RegisterEvents(1);
+
   // Create window with graphics context
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
   SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
@@ -145,11 +177,20 @@ UiApplication::Status Mocker::Initialize() {
   ImGui_ImplOpenGL3_Init(glsl_version);
 
   filesystem_browser_->SetSelectedFilesHandler([this](auto selected_files) {
+    // UI replies of previous selection are dropped at once, destroyed images
+    // cancel their loads waiting in pipeline.
+    if (selection_task_group_) {
+      selection_task_group_->Cancel();
+    }
     selected_images_.clear();
 
+    selection_task_group_ = std::make_shared<TaskGroup>();
+    const auto ui_task_dispatcher =
+        selection_task_group_->Bind(ui_task_dispatcher_);
+
     for (auto&& file : selected_files) {
       selected_images_.push_back(std::make_shared<Image>(
-          std::move(file), ui_task_dispatcher_, filesystem_task_dispatcher_));
+          std::move(file), ui_task_dispatcher, file_load_pipeline_));
 
       auto& image = selected_images_.back();
 
@@ -158,7 +199,9 @@ UiApplication::Status Mocker::Initialize() {
       image->SetErrorHandler([](const auto& path) {
         ImGui::Text("Can't display %s", path.c_str());
       });
-      image->SetProgressHandler([]() {
+      image->SetProgressHandler([this]() {
+        // Spinner is redrawn until image is loaded.
+        is_animating_ = true;
         ImGui::Text("Loading %c",
                     "|/-\\"[static_cast<int>(ImGui::GetTime() / 0.05f) & 3]);
       });
@@ -173,8 +216,17 @@ RunLoopBackendExecutor::IterationStatus Mocker::DrawUi() {
   ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
   ImGuiIO& io = ImGui::GetIO();
 
+  is_animating_ = false;
+
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
+    // Wake-up means tasks have been posted to UI loop, their results are
+    // drawn like any other activity.
+    redraw_frames_count_ = kSettleFramesCount;
+    if (event.type == wake_up_event_type_) {
+      continue;
+    }
+
     ImGui_ImplSDL3_ProcessEvent(&event);
     if (event.type == SDL_EVENT_QUIT) {
       done = true;
@@ -231,6 +283,10 @@ RunLoopBackendExecutor::IterationStatus Mocker::DrawUi() {
 
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
                 1000.0f / io.Framerate, io.Framerate);
+
+    if (ImGui::CollapsingHeader("Metrics")) {
+      DisplayMetrics();
+    }
     ImGui::End();
   }
 
@@ -245,7 +301,58 @@ RunLoopBackendExecutor::IterationStatus Mocker::DrawUi() {
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
   SDL_GL_SwapWindow(window_);
 
-  return done ? RunLoopBackendExecutor::IterationStatus::Done
-              : RunLoopBackendExecutor::IterationStatus::Ok;
+  if (done) {
+    return RunLoopBackendExecutor::IterationStatus::Done;
+  }
+
+  // Text cursor blinks while text is edited.
+  if (is_animating_ || io.WantTextInput) {
+    return RunLoopBackendExecutor::IterationStatus::Ok;
+  }
+
+  if (redraw_frames_count_ > 0) {
+    --redraw_frames_count_;
+    return RunLoopBackendExecutor::IterationStatus::Ok;
+  }
+
+  return RunLoopBackendExecutor::IterationStatus::Idle;
+}
+
+void Mocker::DisplayMetrics() {
+  for (const auto& metric : MetricsRegistry::Get().GetSnapshot()) {
+    auto name = metric.name;
+    for (const auto& [label, value] : metric.labels) {
+      name += " " + label + "=" + value;
+    }
+
+    if (metric.type != MetricType::kHistogram) {
+      ImGui::Text("%s: %lld", name.c_str(),
+                  static_cast<long long>(metric.value));
+      continue;
+    }
+
+    const auto& histogram = metric.histogram;
+    ImGui::Text("%s: count %llu, p50 %llu, p99 %llu", name.c_str(),
+                static_cast<unsigned long long>(histogram.count),
+                static_cast<unsigned long long>(histogram.GetPercentile(0.5)),
+                static_cast<unsigned long long>(histogram.GetPercentile(0.99)));
+  }
+}
+
+void Mocker::WaitForEvent(IntervalNs timeout) {
+  // Round up, so loop doesn't wake before task call time.
+  const auto timeout_ms =
+      timeout == IntervalNs::max()
+          ? -1
+          : static_cast<Sint32>(std::min<IntervalMs::rep>(
+                std::chrono::ceil<IntervalMs>(timeout).count(),
+                std::numeric_limits<Sint32>::max()));
+  SDL_WaitEventTimeout(nullptr, timeout_ms);
+}
+
+void Mocker::WakeUp() {
+  SDL_Event event{};
+  event.type = wake_up_event_type_;
+  SDL_PushEvent(&event);
 }
 }  // namespace mk
\ No newline at end of file
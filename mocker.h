@@ -6,7 +6,10 @@
 #include <memory>
 #include <vector>
 
+#include "base/file_load_pipeline.h"
+#include "base/metrics_file_exporter.h"
 #include "base/run_loop_backend_executor.h"
+#include "base/thread_options.h"
 #include "di_names.h"
 #include "ui_application.h"
 
@@ -15,6 +18,8 @@ class TaskLoop;
 class FilesystemBrowserView;
 class DispatchTask;
 class ImageView;
+class TaskGroup;
+class TaskWatchdog;
 
 class Mocker : public UiApplication {
  public:
@@ -27,8 +32,13 @@ class Mocker : public UiApplication {
           filesystem_task_loop,
       (named = di_names::FilesystemDispatchTask) std::shared_ptr<DispatchTask>
           filesystem_task_dispatcher,
+      (named = di_names::FilesystemThread)
+          ThreadOptions filesystem_thread_options,
       std::shared_ptr<RunLoopBackendExecutor> ui_backend_executor,
-      std::shared_ptr<FilesystemBrowserView> filesystem_browser);
+      std::shared_ptr<FilesystemBrowserView> filesystem_browser,
+      std::shared_ptr<TaskWatchdog> watchdog,
+      MetricsFileExporterOptions metrics_exporter_options,
+      std::shared_ptr<FileLoadPipeline> file_load_pipeline);
 
   /** @see UiApplication. */
   UiApplication::Status Run() override;
@@ -37,17 +47,49 @@ class Mocker : public UiApplication {
   UiApplication::Status Initialize();
   RunLoopBackendExecutor::IterationStatus DrawUi();
 
+  /**
+   * @brief Display metrics snapshot.
+   *
+   */
+  void DisplayMetrics();
+
+  /**
+   * @brief Wait for SDL event. Event stays in queue for DrawUi().
+   *
+   * @param timeout Longest wait.
+   */
+  void WaitForEvent(IntervalNs timeout);
+
+  /**
+   * @brief Interrupt WaitForEvent() from any thread.
+   *
+   */
+  void WakeUp();
+
   std::shared_ptr<TaskLoop> ui_task_loop_;
   std::shared_ptr<TaskLoop> filesystem_task_loop_;
   std::shared_ptr<DispatchTask> filesystem_task_dispatcher_;
+  ThreadOptions filesystem_thread_options_;
   std::shared_ptr<DispatchTask> ui_task_dispatcher_;
+  /// Reads selected files and decodes them on filesystem thread pool.
+  std::shared_ptr<FileLoadPipeline> file_load_pipeline_;
   std::shared_ptr<RunLoopBackendExecutor> ui_backend_executor_;
   std::shared_ptr<FilesystemBrowserView> filesystem_browser_;
+  std::shared_ptr<TaskWatchdog> watchdog_;
+  MetricsFileExporterOptions metrics_exporter_options_;
 
   SDL_GLContext gl_context_;
   SDL_Window* window_;
   bool show_demo_window_;
 
+  Uint32 wake_up_event_type_;
+  /// Frames to redraw after last change, so ImGui settles hover state.
+  int redraw_frames_count_;
+  /// Something animates in current frame, e.g. progress spinner.
+  bool is_animating_;
+
   std::vector<std::shared_ptr<ImageView>> selected_images_;
+  /// Tasks of selected images.
+  std::shared_ptr<TaskGroup> selection_task_group_;
 };
 }  // namespace mk
\ No newline at end of file